@@ -6,6 +6,134 @@
 #include "cache.h"
 #include "print_helpers.h"
 
+static access_fn_t select_access_fn(enum protocol_t protocol, bool sectored_f);
+
+// largest prime <= n (1 for n < 2), the number of sets INDEX_PRIME uses
+static int largest_prime_at_most(int n) {
+  for (int p = n; p >= 2; p--) {
+    bool prime_f = true;
+    for (int d = 2; d * d <= p && prime_f; d++) {
+      prime_f = (p % d != 0);
+    }
+    if (prime_f) {
+      return p;
+    }
+  }
+  return 1;
+}
+
+/* Multiplicative hash of a block number for way `way` of a skewed cache;
+ * every way uses a different odd multiplier, so blocks that conflict in
+ * one way are spread out in the others.
+ */
+static unsigned long skew_hash(cache_t *cache, unsigned long block, int way) {
+  if (cache->n_index_bit == 0) {
+    return 0;
+  }
+  unsigned long folded = (block ^ (block >> 32)) & 0xffffffffUL;  // bring in any ASID bits
+  unsigned long multiplier = 0x9E3779B1UL + 2UL * way * 0x85EBCA6BUL;
+  return ((folded * multiplier) & 0xffffffffUL) >> (32 - cache->n_index_bit);
+}
+
+/* Set index of addr under the given index function. For INDEX_SKEW this
+ * is way 0's set; way_set gives the others.
+ */
+static inline unsigned long cache_set_index(cache_t *cache, unsigned long addr, const enum index_fn_t index_fn) {
+  unsigned long block = addr >> cache->n_offset_bit;
+
+  switch (index_fn) {
+  case INDEX_MODULO:
+    break;
+  case INDEX_XOR: {
+    // fold every n_index_bit-wide slice of the block number onto the index
+    unsigned long index = 0;
+    while (cache->n_index_bit > 0 && block) {
+      index ^= block;
+      block >>= cache->n_index_bit;
+    }
+    return index & cache->index_mask;
+  }
+  case INDEX_PRIME:
+    return block % cache->n_prime_set;
+  case INDEX_SKEW:
+    return skew_hash(cache, block, 0);
+  }
+  return block & cache->index_mask;
+}
+
+// the set holding way of addr: the same for every way unless skewed
+static inline unsigned long way_set(cache_t *cache, unsigned long addr, unsigned long index, int way,
+                                    const enum index_fn_t index_fn) {
+  if (index_fn != INDEX_SKEW || way == 0) {
+    return index;
+  }
+  return skew_hash(cache, addr >> cache->n_offset_bit, way);
+}
+
+// the bit of addr's sector within its line, for sector_bits_t
+static inline unsigned long sector_bit(cache_t *cache, unsigned long addr) {
+  return 1UL << ((addr >> cache->n_sector_bit) & (cache->n_sector - 1));
+}
+
+// per-set access and miss counts for the occupancy histogram, if enabled
+static inline void count_set_access(cache_t *cache, unsigned long set, bool hit, enum action_t action) {
+  if (cache->set_accesses && (action == LOAD || action == STORE)) {
+    cache->set_accesses[set]++;
+    if (!hit) {
+      cache->set_misses[set]++;
+    }
+  }
+}
+
+/* Set-dueling for INSERT_DIP: decides whether a line filled into set index
+ * goes in at low priority. Misses in the MRU leader sets count against MRU
+ * insertion, misses in the bimodal leaders against bimodal insertion, and
+ * the other sets follow whichever is missing less.
+ */
+static bool low_priority_fill(cache_t *cache, unsigned long index) {
+  const int psel_max = (1 << PSEL_BITS) - 1;
+  bool bimodal_f;
+
+  switch (index % DUEL_SPACING) {
+  case 0:
+    if (cache->psel < psel_max) cache->psel++;
+    return false;
+  case 1:
+    if (cache->psel > 0) cache->psel--;
+    bimodal_f = true;
+    break;
+  default:
+    bimodal_f = cache->psel > psel_max / 2;
+  }
+
+  // bimodal: every BIP_EPSILON-th fill still goes in at MRU
+  return bimodal_f && (cache->n_bip_fills++ % BIP_EPSILON) != 0;
+}
+
+/* Updates the replacement pointer of set index after a miss filled way.
+ * By default the new line becomes most recently used, like a hit. A low
+ * priority fill leaves the pointer on the new line instead, so a streaming
+ * block that is never reused only ever displaces that one way of its set.
+ */
+static inline void insert_line(cache_t *cache, unsigned long index, int way, const int assoc) {
+  if (cache->insert_policy == INSERT_DIP && low_priority_fill(cache, index)) {
+    cache->n_low_priority_fills++;
+    return;
+  }
+  cache->lru_way[index] = (way + 1) % assoc;
+}
+
+/* Called when a snoop invalidates way of set index. With
+ * lru_on_invalidate_f the freed way becomes the set's next victim, so the
+ * next miss refills it instead of evicting a valid line.
+ */
+static inline void invalidate_lru(cache_t *cache, unsigned long index, int way) {
+  if (cache->lru_on_invalidate_f) {
+    cache->lru_way[index] = way;
+  }
+}
+
+
 cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t protocol, bool lru_on_invalidate_f) {
   cache_t *cache = malloc(sizeof(cache_t));
   cache->stats = make_cache_stats();
@@ -21,6 +149,11 @@ cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t pro
   cache->n_index_bit = log2(cache->n_set); // log2 bits required to index the number of sets
   cache->n_tag_bit = 32 - cache->n_index_bit - cache->n_offset_bit; // remaining bits are tag
 
+  // masks and shifts used on every access, computed once here
+  cache->index_mask = (1UL << cache->n_index_bit) - 1;
+  cache->tag_mask = (1UL << cache->n_tag_bit) - 1;
+  cache->tag_shift = cache->n_index_bit + cache->n_offset_bit;
+
   // next create the cache lines and the array of LRU bits
   // - malloc an array with n_rows
   // - for each element in the array, malloc another array with n_col
@@ -56,12 +189,231 @@ cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t pro
     }
   }
 
+  // a single sector covering the whole block until enable_sectors
+  cache->sector_size = block_size;
+  cache->n_sector = 1;
+  cache->n_sector_bit = cache->n_offset_bit;
+  cache->sectors = NULL;
+
+  // plain low-order index bits, no per-set histogram until asked for
+  cache->index_fn = INDEX_MODULO;
+  cache->n_prime_set = largest_prime_at_most(cache->n_set);
+  cache->set_accesses = NULL;
+  cache->set_misses = NULL;
+
+  // no write buffer or event log unless the simulator attaches one
+  cache->wbuf = NULL;
+  cache->tlb = NULL;
+  cache->event_log = NULL;
+  cache->core_id = 0;
+
+  // nothing accessed yet
+  cache->last_set = 0;
+  cache->last_way = 0;
+  cache->last_upgrade_f = false;
+
   cache->protocol = protocol;
   cache->lru_on_invalidate_f = lru_on_invalidate_f;
+
+  // misses insert at MRU until enable_adaptive_insertion
+  cache->insert_policy = INSERT_MRU;
+  cache->psel = (1 << PSEL_BITS) / 2;
+  cache->n_bip_fills = 0;
+  cache->n_low_priority_fills = 0;
+  cache->insert_fn = NULL;
+  cache->shadow = NULL;
+
+  // resolve the protocol and associativity dispatch once, instead of on every access
+  cache->access_fn = select_access_fn(protocol, false);
   
   return cache;
 }
 
+/* Releases everything allocated by make_cache. */
+void free_cache(cache_t *cache) {
+  for (int i = 0; i < cache->n_set; i++) {
+    free(cache->lines[i]);
+  }
+  free(cache->lines);
+  if (cache->sectors) {
+    for (int i = 0; i < cache->n_set; i++) {
+      free(cache->sectors[i]);
+    }
+    free(cache->sectors);
+  }
+  free(cache->lru_way);
+  free(cache->set_accesses);
+  free(cache->set_misses);
+  if (cache->wbuf) {
+    free_write_buffer(cache->wbuf);
+  }
+  if (cache->tlb) {
+    free_tlb(cache->tlb);
+  }
+  if (cache->shadow) {
+    free_cache(cache->shadow);
+  }
+  free(cache->stats);
+  free(cache);
+}
+
+/* Returns true if capacity, block_size and assoc describe a cache make_cache
+ * can build: both sizes powers of two and at least one set.
+ */
+bool valid_cache_geometry(int capacity, int block_size, int assoc) {
+  if (capacity <= 0 || block_size <= 0 || assoc <= 0) {
+    return false;
+  }
+  if ((capacity & (capacity - 1)) != 0 || (block_size & (block_size - 1)) != 0) {
+    return false;
+  }
+  return capacity / block_size / assoc > 0;
+}
+
+/* Widens the tag by ASID_BITS so the address space id placed above the
+ * ADDRESS_SIZE-bit address becomes part of every line's tag. Lines of
+ * different processes then never match each other, even when their
+ * virtual addresses are the same.
+ */
+void enable_asid_tags(cache_t *cache) {
+  cache->tag_mask = (cache->tag_mask << ASID_BITS) | ((1UL << ASID_BITS) - 1);
+}
+
+/* Invalidates every line, as a context switch does on a cache without ASID
+ * tags. Dirty lines are written back first and counted in the stats.
+ * Returns the number of writebacks.
+ */
+int flush_cache(cache_t *cache) {
+  int n_writebacks = 0;
+
+  for (int i = 0; i < cache->n_set; i++) {
+    for (int j = 0; j < cache->assoc; j++) {
+      cache_line_t *line = &cache->lines[i][j];
+      // MSI tracks dirtiness in the state, the other protocols in dirty_f
+      if (line->state != INVALID && (line->dirty_f || line->state == MODIFIED)) {
+        n_writebacks++;
+      }
+      if (cache->sectors) {
+        sector_bits_t *sectors = &cache->sectors[i][j];
+        cache->stats->n_sector_writebacks += __builtin_popcountl(sectors->valid & sectors->dirty);
+        sectors->valid = 0;
+        sectors->dirty = 0;
+      }
+      line->state = INVALID;
+      line->dirty_f = false;
+    }
+  }
+
+  cache->stats->n_writebacks += n_writebacks;
+  cache->stats->n_switch_writebacks += n_writebacks;
+  if (cache->shadow) {
+    flush_cache(cache->shadow);
+  }
+  return n_writebacks;
+}
+
+/* Switches the cache to another set index function. The hashed functions
+ * keep the whole block number as the tag, since the index bits can no
+ * longer be recovered from the set. Call right after make_cache.
+ */
+void set_index_function(cache_t *cache, enum index_fn_t index_fn) {
+  cache->index_fn = index_fn;
+
+  if (index_fn == INDEX_MODULO) {
+    cache->tag_mask = (1UL << cache->n_tag_bit) - 1;
+    cache->tag_shift = cache->n_index_bit + cache->n_offset_bit;
+  } else {
+    cache->tag_mask = (1UL << (cache->n_tag_bit + cache->n_index_bit)) - 1;
+    cache->tag_shift = cache->n_offset_bit;
+  }
+}
+
+/* Starts counting accesses and misses per set, for print_set_histogram. */
+void enable_set_histogram(cache_t *cache) {
+  cache->set_accesses = calloc(cache->n_set, sizeof(long));
+  cache->set_misses = calloc(cache->n_set, sizeof(long));
+}
+
+/* True if sector_size is a power of two dividing a block of block_size
+ * Bytes into at most SECTOR_MAX sectors.
+ */
+bool valid_sector_size(int block_size, int sector_size) {
+  return sector_size > 0 && (sector_size & (sector_size - 1)) == 0 && sector_size <= block_size &&
+      block_size / sector_size <= SECTOR_MAX;
+}
+
+/* Splits every line into block_size / sector_size sectors that are
+ * fetched, written back and invalidated on their own, while the line keeps
+ * a single tag. Call right after make_cache.
+ * Returns 0 on success, -1 if !valid_sector_size.
+ */
+int enable_sectors(cache_t *cache, int sector_size) {
+  if (!valid_sector_size(cache->block_size, sector_size)) {
+    return -1;
+  }
+
+  cache->sector_size = sector_size;
+  cache->n_sector = cache->block_size / sector_size;
+  cache->n_sector_bit = log2(sector_size);
+  cache->sectors = malloc(cache->n_set * sizeof(sector_bits_t*));
+  for (int i = 0; i < cache->n_set; i++) {
+    cache->sectors[i] = calloc(cache->assoc, sizeof(sector_bits_t));
+  }
+  cache->stats->sector_size = sector_size;
+
+  cache->access_fn = select_access_fn(cache->protocol, true);
+  return 0;
+}
+
+// access_fn under adaptive insertion: the cache itself, then its shadow
+static bool adaptive_access(cache_t *cache, unsigned long addr, enum action_t action) {
+  bool hit = cache->insert_fn(cache, addr, action);
+  cache->shadow->access_fn(cache->shadow, addr, action);
+  return hit;
+}
+
+/* Switches the cache to INSERT_DIP, so streaming blocks that are never
+ * reused stop flushing the rest of each set. A shadow copy of the cache
+ * keeps default MRU insertion and is fed the same accesses and snoops;
+ * its stats are what the run would have given without adaptive insertion.
+ * Call after the other enable_* and set_* functions, which the shadow
+ * copies.
+ */
+void enable_adaptive_insertion(cache_t *cache) {
+  cache_t *shadow = make_cache(cache->capacity, cache->block_size, cache->assoc, cache->protocol,
+                               cache->lru_on_invalidate_f);
+  if (cache->index_fn != INDEX_MODULO) {
+    set_index_function(shadow, cache->index_fn);
+  }
+  if (cache->sectors) {
+    enable_sectors(shadow, cache->sector_size);
+  }
+  shadow->tag_mask = cache->tag_mask;  // ASID tags, if enabled
+  cache->shadow = shadow;
+
+  cache->insert_policy = INSERT_DIP;
+  cache->insert_fn = cache->access_fn;
+  cache->access_fn = adaptive_access;
+}
+
+/* Returns true if the block containing addr is in the cache in any valid
+ * state (for a sectored cache, the sector containing addr). Unlike
+ * access_cache it changes nothing, not even the stats.
+ */
+bool probe_cache(cache_t *cache, unsigned long addr) {
+  unsigned long index = cache_set_index(cache, addr, cache->index_fn);
+  unsigned long tag = (addr >> cache->tag_shift) & cache->tag_mask;
+
+  for (int i = 0; i < cache->assoc; i++) {
+    cache_line_t *line = &cache->lines[way_set(cache, addr, index, i, cache->index_fn)][i];
+    if (line->tag == tag && line->state != INVALID) {
+      unsigned long set = way_set(cache, addr, index, i, cache->index_fn);
+      return cache->sectors == NULL || (cache->sectors[set][i].valid & sector_bit(cache, addr)) != 0;
+    }
+  }
+  return false;
+}
+
 /* Given a configured cache, returns the tag portion of the given address.
  *
  * Example: a cache with 4 bits each in tag, index, offset
@@ -69,13 +421,9 @@ cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t pro
  * in decimal -- get_cache_tag(3921) returns 15 
  */
 unsigned long get_cache_tag(cache_t *cache, unsigned long addr) {
-  unsigned long tag_mask = (1 << cache->n_tag_bit) - 1; // produces n_tag_bit ones
-
-  // shift the stuff which isn't index or offset (necessarily the tag) into the LSBs
-  addr = addr >> (cache->n_index_bit + cache->n_offset_bit); 
-
-
-  return (addr & tag_mask); // and with tag_mask to obtain the n_tag_bit bits corresponding to the tag
+  // the same shift and mask as the kernels: set_index_function and
+  // enable_asid_tags adjust them, so hashed indexing and ASIDs are covered
+  return (addr >> cache->tag_shift) & cache->tag_mask;
 }
 
 /* Given a configured cache, returns the index portion of the given address.
@@ -85,6 +433,11 @@ unsigned long get_cache_tag(cache_t *cache, unsigned long addr) {
  * in decimal -- get_cache_index(3921) returns 5
  */
 unsigned long get_cache_index(cache_t *cache, unsigned long addr) {
+  // hashed index functions (way 0's set for a skewed cache)
+  if (cache->index_fn != INDEX_MODULO) {
+    return cache_set_index(cache, addr, cache->index_fn);
+  }
+
   unsigned long index_mask = 1 << cache->n_index_bit; // shift 1 by n_index_bit bits
   index_mask -= 1; // result is n_index_bit set bits
   addr = addr >> cache->n_offset_bit; // shift the stuff which isn't offset into the LSBs
@@ -108,21 +461,44 @@ unsigned long get_cache_block_addr(cache_t *cache, unsigned long addr) {
   return block_addr; // return the block address
 }
 
+/* Given a configured cache, returns the given address rounded down to its
+ * sector. Same as get_cache_block_addr unless the lines are sectored.
+ */
+unsigned long get_cache_sector_addr(cache_t *cache, unsigned long addr) {
+  return addr & ~(unsigned long)(cache->sector_size - 1);
+}
+
+
+/* The protocol handlers below are inline kernels taking the associativity
+ * and index function; the handle_*_protocol wrappers pass the cache's own.
+ */
+
+// appends the outcome of an access to the binary event log, if one is open
+static inline void record_event(cache_t *cache, unsigned long addr, enum action_t action, unsigned long index,
+                                int way, enum state_t old_state, enum state_t new_state, bool hit,
+                                bool writeback_f, bool upgrade_miss) {
+  if (cache->event_log) {
+    int flags = (hit ? EVENT_HIT : 0) | (writeback_f ? EVENT_WRITEBACK : 0) | (upgrade_miss ? EVENT_UPGRADE_MISS : 0);
+    write_event(cache->event_log, cache->core_id, addr, action, index, way, old_state, new_state, flags);
+  }
+}
 
 //helper 1: handle no coherence protocol
-bool handle_no_coherence_protocol(cache_t *cache, unsigned long addr, enum action_t action) {
-  unsigned long index = get_cache_index(cache, addr); // obtain target index
-  unsigned long tag = get_cache_tag(cache, addr); // obtain target tag
+static inline bool none_kernel(cache_t *cache, unsigned long addr, enum action_t action, const int assoc,
+                               const enum index_fn_t index_fn) {
+  unsigned long index = cache_set_index(cache, addr, index_fn); // obtain target index (way 0's set if skewed)
+  unsigned long tag = (addr >> cache->tag_shift) & cache->tag_mask; // obtain target tag
   
   int way = cache->lru_way[index]; // tracks which way our line is in. starts here to make lru updating easier. 
   bool hit = false; // flag to indicate whether we got a hit, default false
   bool writeback_f = false; // flag to indicate whether to writeback, default false
 
   // Search for the address in the cache: we already know the set, now search the ways:
-  for (int i = 0; i < cache->assoc; i++) {
+  for (int i = 0; i < assoc; i++) {
+    cache_line_t *candidate = &cache->lines[way_set(cache, addr, index, i, index_fn)][i];
     // if the tag matches and the line is valid,
-    if (cache->lines[index][i].tag == tag) {
-      if (cache->lines[index][i].state == VALID) {
+    if (candidate->tag == tag) {
+      if (candidate->state == VALID) {
         // set the hit flag, update the way, and exit the loop
         hit = true;
         way = i;
@@ -132,17 +508,19 @@ bool handle_no_coherence_protocol(cache_t *cache, unsigned long addr, enum actio
   }
 
   // get a pointer to the line we found for easier operations
-  cache_line_t *line = &cache->lines[index][way];
+  unsigned long set = way_set(cache, addr, index, way, index_fn); // differs from index only when skewed
+  cache_line_t *line = &cache->lines[set][way];
+  enum state_t old_state = line->state; // for the event log
   
   // log the way and index
-  log_way(way);
-  log_set(index);
+  log_way(cache, way);
+  log_set(cache, set);
 
   if (hit) {
     // Cache hit
     // Update LRU since hit, if the action is from an active core
     if (action == STORE || action == LOAD) {
-      cache->lru_way[index] = (way + 1) % cache->assoc;
+      cache->lru_way[index] = (way + 1) % assoc;
     }
 
     // if the action was a store, update the dirty bit as well
@@ -167,32 +545,36 @@ bool handle_no_coherence_protocol(cache_t *cache, unsigned long addr, enum actio
       line->dirty_f = (action == STORE);
 
       // update LRU way
-      cache->lru_way[index] = (way + 1) % cache->assoc;
+      insert_line(cache, index, way, assoc);
 
     }
     // do nothing on LD_MISS or ST_MISS
   }
 
   // then, update the stats
+  record_event(cache, addr, action, set, way, old_state, line->state, hit, writeback_f, false);
   update_stats(cache->stats, hit, writeback_f, false, action);
+  count_set_access(cache, set, hit, action);
 
   return hit;
 }
 
 //helper 2: handle VI protocol
-bool handle_vi_protocol(cache_t *cache, unsigned long addr, enum action_t action) {
-  unsigned long index = get_cache_index(cache, addr); // obtain target index
-  unsigned long tag = get_cache_tag(cache, addr); // obtain target tag
+static inline bool vi_kernel(cache_t *cache, unsigned long addr, enum action_t action, const int assoc,
+                               const enum index_fn_t index_fn) {
+  unsigned long index = cache_set_index(cache, addr, index_fn); // obtain target index (way 0's set if skewed)
+  unsigned long tag = (addr >> cache->tag_shift) & cache->tag_mask; // obtain target tag
   
   int way = cache->lru_way[index]; // tracks which way our line is in. starts here to make lru updating easier. 
   bool hit = false; // flag to indicate whether we got a hit, default false
   bool writeback_f = false; // flag to indicate whether to writeback, default false
 
   // Search for the address in the cache
-  for (int i = 0; i < cache->assoc; i++) {
+  for (int i = 0; i < assoc; i++) {
+    cache_line_t *candidate = &cache->lines[way_set(cache, addr, index, i, index_fn)][i];
     // if the tag matches and the line is valid,
-    if (cache->lines[index][i].tag == tag) {
-      if (cache->lines[index][i].state == VALID) {
+    if (candidate->tag == tag) {
+      if (candidate->state == VALID) {
           // update the hit flag, set the way we found, and exit
           hit = true;
           way = i;
@@ -203,11 +585,13 @@ bool handle_vi_protocol(cache_t *cache, unsigned long addr, enum action_t action
   }
 
   // get a pointer to the line we found for easier operations
-  cache_line_t *line = &cache->lines[index][way];
+  unsigned long set = way_set(cache, addr, index, way, index_fn); // differs from index only when skewed
+  cache_line_t *line = &cache->lines[set][way];
+  enum state_t old_state = line->state; // for the event log
 
   // log the way and index
-  log_way(way);
-  log_set(index);
+  log_way(cache, way);
+  log_set(cache, set);
   
   if (hit) {
     // Cache hit
@@ -218,12 +602,13 @@ bool handle_vi_protocol(cache_t *cache, unsigned long addr, enum action_t action
       if (action == STORE){
         line->dirty_f = true; // on store, additionally update dirty bit
       }
-      cache->lru_way[index] = (way + 1) % cache->assoc; // update LRU
+      cache->lru_way[index] = (way + 1) % assoc; // update LRU
     } else {
       // LD_MISS or ST_MISS
       bool dirty = line->dirty_f; // check if dirty
 
       line->state = INVALID; // invalidate 
+      invalidate_lru(cache, index, way);
       hit = false; // also set hit to false
 
       // if the line was dirty,
@@ -241,10 +626,9 @@ bool handle_vi_protocol(cache_t *cache, unsigned long addr, enum action_t action
       // set valid state and tag
       line->state = VALID;
       line->tag = tag;
-      if (action == STORE){
-        line->dirty_f = true; // additionally set dirty: brought into cache and written
-      }
-      cache->lru_way[index] = (way + 1) % cache->assoc; // update LRU
+      // clean on a load, dirty on a store: the evicted line's dirty bit must not carry over
+      line->dirty_f = (action == STORE);
+      insert_line(cache, index, way, assoc); // update LRU
     }/*  else {
       // otherwise, LD_MISS or ST_MISS
       bool dirty = line->dirty_f; // check if dirty
@@ -258,15 +642,18 @@ bool handle_vi_protocol(cache_t *cache, unsigned long addr, enum action_t action
     } */
   }
   // then, update the stats
+  record_event(cache, addr, action, set, way, old_state, line->state, hit, writeback_f, false);
   update_stats(cache->stats, hit, writeback_f, false, action);
+  count_set_access(cache, set, hit, action);
   return hit;
 
 }
 
 //helper 3: handle MSI protocol
-bool handle_msi_protocol(cache_t *cache, unsigned long addr, enum action_t action) {
-  unsigned long index = get_cache_index(cache, addr); // obtain target index
-  unsigned long tag = get_cache_tag(cache, addr); // obtain target tag
+static inline bool msi_kernel(cache_t *cache, unsigned long addr, enum action_t action, const int assoc,
+                               const enum index_fn_t index_fn) {
+  unsigned long index = cache_set_index(cache, addr, index_fn); // obtain target index (way 0's set if skewed)
+  unsigned long tag = (addr >> cache->tag_shift) & cache->tag_mask; // obtain target tag
   
   int way = cache->lru_way[index]; // tracks which way our line is in. starts here to make lru updating easier. 
   bool hit = false; // flag to indicate whether we got a hit, default false
@@ -275,10 +662,11 @@ bool handle_msi_protocol(cache_t *cache, unsigned long addr, enum action_t actio
   bool upgrade_miss = false; // flag to indicate whether an upgrade miss occurred
 
   // Search for the address in the cache
-  for (int i = 0; i < cache->assoc; i++) {
+  for (int i = 0; i < assoc; i++) {
+    cache_line_t *candidate = &cache->lines[way_set(cache, addr, index, i, index_fn)][i];
     // if the tag matches and the line is valid,
-    if (cache->lines[index][i].tag == tag) {
-      if (cache->lines[index][i].state != INVALID){
+    if (candidate->tag == tag) {
+      if (candidate->state != INVALID){
           // set the hit flag, update the way, and exit the loop
           hit = true;
           way = i;
@@ -288,17 +676,19 @@ bool handle_msi_protocol(cache_t *cache, unsigned long addr, enum action_t actio
   }
 
   // get a pointer to the line we found for easier operations
-  cache_line_t *line = &cache->lines[index][way];
+  unsigned long set = way_set(cache, addr, index, way, index_fn); // differs from index only when skewed
+  cache_line_t *line = &cache->lines[set][way];
+  enum state_t old_state = line->state; // for the event log
 
   // log the way and index
-  log_way(way);
-  log_set(index);
+  log_way(cache, way);
+  log_set(cache, set);
 
   if (hit) {
     // Cache hit: line in M or S states
     if (action == LOAD) {
       // transition on load for M and S keeps the state the same, so just update LRU way
-      cache->lru_way[index] = (way + 1) % cache->assoc; // update LRU way
+      cache->lru_way[index] = (way + 1) % assoc; // update LRU way
     } else if (action == STORE) {
       // only relevant transition is from S to M: M stays M
       if (line->state == SHARED) {
@@ -307,11 +697,12 @@ bool handle_msi_protocol(cache_t *cache, unsigned long addr, enum action_t actio
         hit = false; // necessary for the way that we handle stats
         upgrade_miss = true;
       }
-      cache->lru_way[index] = (way + 1) % cache->assoc; // update LRU way
+      cache->lru_way[index] = (way + 1) % assoc; // update LRU way
     } else if (action == ST_MISS) {
       // Store miss: M and S both transition to invalid
       bool dirty = (line->state == MODIFIED); // if modified, was dirty
       line->state = INVALID;
+      invalidate_lru(cache, index, way);
       if (dirty) {
         writeback_f = true; // if dirty, requires writeback
       }
@@ -333,16 +724,145 @@ bool handle_msi_protocol(cache_t *cache, unsigned long addr, enum action_t actio
 
       // update tag and LRU
       line->tag = tag; 
-      cache->lru_way[index] = (way + 1) % cache->assoc;
+      insert_line(cache, index, way, assoc);
     }
     // if hit is false, then writeback_f and upgrade_miss are never changed and thus remain false
     // never require writeback from a miss
   }
   // then, update the stats
+  cache->last_upgrade_f = upgrade_miss;
+  record_event(cache, addr, action, set, way, old_state, line->state, hit, writeback_f, upgrade_miss);
+  update_stats(cache->stats, hit, writeback_f, upgrade_miss, action);
+  count_set_access(cache, set, hit, action);
+  return hit;
+}
+
+/* Sectored lines, for every protocol. Hits need both the tag and the
+ * sector; a sector miss under a matching tag fetches just that sector
+ * without evicting anything. The protocols otherwise follow the kernels
+ * above, applied to the sector: a snoop only invalidates or downgrades the
+ * sector it names, and evicting a line writes back its dirty sectors.
+ * Sector writebacks are counted where n_writebacks is: on evictions (which
+ * MSI, like msi_kernel, does not count) and flushes. The line's own state
+ * and dirty flag summarise its sectors, for flush_cache and verbose
+ * printing.
+ */
+static bool sector_kernel(cache_t *cache, unsigned long addr, enum action_t action) {
+  unsigned long index = cache_set_index(cache, addr, cache->index_fn);
+  unsigned long tag = (addr >> cache->tag_shift) & cache->tag_mask;
+  unsigned long bit = sector_bit(cache, addr);
+  bool core_f = (action == LOAD || action == STORE);
+
+  int way = cache->lru_way[index];
+  bool tag_hit = false;
+  bool writeback_f = false;
+  bool upgrade_miss = false;
+
+  for (int i = 0; i < cache->assoc; i++) {
+    cache_line_t *candidate = &cache->lines[way_set(cache, addr, index, i, cache->index_fn)][i];
+    if (candidate->tag == tag && candidate->state != INVALID) {
+      tag_hit = true;
+      way = i;
+      break;
+    }
+  }
+
+  unsigned long set = way_set(cache, addr, index, way, cache->index_fn);
+  cache_line_t *line = &cache->lines[set][way];
+  sector_bits_t *sectors = &cache->sectors[set][way];
+  enum state_t old_state = line->state;
+  bool hit = tag_hit && (sectors->valid & bit);
+
+  log_way(cache, way);
+  log_set(cache, set);
+
+  if (core_f) {
+    if (!tag_hit) {
+      // evict the whole line, then take it over with just this sector
+      unsigned long dirty = (line->state != INVALID) ? sectors->valid & sectors->dirty : 0;
+      if (dirty && cache->protocol != MSI) {
+        writeback_f = true;
+        cache->stats->n_sector_writebacks += __builtin_popcountl(dirty);
+      }
+      line->tag = tag;
+      sectors->valid = 0;
+      sectors->dirty = 0;
+    }
+    if (!hit) {
+      sectors->valid |= bit;
+      cache->stats->n_sector_fills++;
+    } else if (action == STORE && cache->protocol == MSI && !(sectors->dirty & bit)) {
+      // S -> M: the data is here, only the other copies need invalidating
+      hit = false;
+      upgrade_miss = true;
+    }
+    if (action == STORE) {
+      sectors->dirty |= bit;
+    }
+    if (tag_hit) {
+      cache->lru_way[index] = (way + 1) % cache->assoc;
+    } else {
+      insert_line(cache, index, way, cache->assoc);
+    }
+  } else if (hit && cache->protocol != NONE) {
+    writeback_f = (sectors->dirty & bit) != 0;
+    sectors->dirty &= ~bit;
+    if (cache->protocol == VI || action == ST_MISS) {
+      sectors->valid &= ~bit;
+      if (sectors->valid == 0) {
+        invalidate_lru(cache, index, way);
+      }
+    }
+    if (cache->protocol == VI) {
+      hit = false;  // as vi_kernel counts it
+    }
+  }
+
+  // the line's summary of its sectors
+  if (sectors->valid == 0) {
+    line->state = INVALID;
+  } else if (cache->protocol == MSI) {
+    line->state = sectors->dirty ? MODIFIED : SHARED;
+  } else {
+    line->state = VALID;
+  }
+  line->dirty_f = (cache->protocol != MSI && sectors->dirty != 0);
+
+  cache->last_upgrade_f = upgrade_miss;
+  record_event(cache, addr, action, set, way, old_state, line->state, hit, writeback_f, upgrade_miss);
   update_stats(cache->stats, hit, writeback_f, upgrade_miss, action);
+  count_set_access(cache, set, hit, action);
   return hit;
 }
 
+bool handle_no_coherence_protocol(cache_t *cache, unsigned long addr, enum action_t action) {
+  return none_kernel(cache, addr, action, cache->assoc, cache->index_fn);
+}
+
+bool handle_vi_protocol(cache_t *cache, unsigned long addr, enum action_t action) {
+  return vi_kernel(cache, addr, action, cache->assoc, cache->index_fn);
+}
+
+bool handle_msi_protocol(cache_t *cache, unsigned long addr, enum action_t action) {
+  return msi_kernel(cache, addr, action, cache->assoc, cache->index_fn);
+}
+
+/* Picks the access handler for a cache. Called once from make_cache (and
+ * again when sectoring is enabled) so access_cache does not have to branch
+ * on the protocol every time.
+ */
+static access_fn_t select_access_fn(enum protocol_t protocol, bool sectored_f) {
+  if (sectored_f) {
+    return sector_kernel;
+  }
+  if (protocol == NONE) {
+    return handle_no_coherence_protocol;
+  } else if (protocol == VI) {
+    return handle_vi_protocol;
+  }
+  return handle_msi_protocol;
+}
+
 
 
 /* this method takes a cache, an address, and an action
@@ -354,15 +874,52 @@ bool handle_msi_protocol(cache_t *cache, unsigned long addr, enum action_t actio
  * Use the "get" helper functions above. They make your life easier.
  */
 bool access_cache(cache_t *cache, unsigned long addr, enum action_t action) {
-  // use the handler for the relevant protocol
-  if (cache->protocol == NONE) {
-    return handle_no_coherence_protocol(cache, addr, action);
-  } else if (cache->protocol == VI) {
-    return handle_vi_protocol(cache, addr, action);
-  } else if (cache->protocol == MSI) {
-    return handle_msi_protocol(cache, addr, action);
+  // use the handler selected for this cache's protocol
+  return cache->access_fn(cache, addr, action);
+}
+
+/* Batched form of access_cache: performs accesses addrs[0..n) with the
+ * matching actions, in order, exactly as n calls to access_cache would.
+ * Bit i of hit_bitmap (HIT_BITMAP_WORDS(n) words) is set if access i hit.
+ * Returns the number of hits.
+ *
+ * The set indices for each chunk are computed up front and the target sets
+ * are prefetched, so the loads overlap instead of stalling one by one.
+ */
+int access_cache_batch(cache_t *cache, const unsigned long *addrs, const enum action_t *actions, int n,
+                       unsigned long *hit_bitmap) {
+  const int bits_per_word = 8 * sizeof(unsigned long);
+  unsigned long index[ACCESS_BATCH_MAX];
+  int n_hits = 0;
+
+  for (int w = 0; w < (int)HIT_BITMAP_WORDS(n); w++) {
+    hit_bitmap[w] = 0;
   }
 
-  return false; // just to get the compiler to stop giving warnings
-}
+  for (int base = 0; base < n; base += ACCESS_BATCH_MAX) {
+    int count = (n - base < ACCESS_BATCH_MAX) ? n - base : ACCESS_BATCH_MAX;
+
+    // first pass: compute every index and prefetch the set pointers and LRU counters
+    for (int i = 0; i < count; i++) {
+      index[i] = cache_set_index(cache, addrs[base + i], cache->index_fn);
+      __builtin_prefetch(&cache->lines[index[i]]);
+      __builtin_prefetch(&cache->lru_way[index[i]], 1);
+    }
+
+    // second pass: prefetch the ways of each target set
+    for (int i = 0; i < count; i++) {
+      __builtin_prefetch(cache->lines[index[i]], 1);
+    }
+
+    // finally process the accesses in order, so semantics match access_cache
+    for (int i = 0; i < count; i++) {
+      int k = base + i;
+      if (cache->access_fn(cache, addrs[k], actions[k])) {
+        hit_bitmap[k / bits_per_word] |= 1UL << (k % bits_per_word);
+        n_hits++;
+      }
+    }
+  }
 
+  return n_hits;
+}
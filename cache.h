@@ -4,11 +4,22 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include "cache_stats.h"
+#include "event_log.h"
+#include "write_buffer.h"
+#include "tlb.h"
 
 #define ADDRESS_SIZE 32  // in bits
+#define ASID_BITS 8      // address space ids sit just above the address, see enable_asid_tags
 #define HIT 1
 #define MISS 0
 
+// access_cache_batch works through its input in chunks of at most this many accesses
+#define ACCESS_BATCH_MAX 64
+// runs shorter than this are not worth batching (see flush_run)
+#define BATCH_MIN_RUN 8
+// number of unsigned longs needed for a hit bitmap covering n accesses
+#define HIT_BITMAP_WORDS(n) (((n) + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long)))
+
 // {INVALID, VALID} for VI, {INVALID, SHARED, MODIFIED} for MSI 
 enum state_t { INVALID, VALID, SHARED, MODIFIED };
 
@@ -22,7 +33,43 @@ typedef struct {
   enum state_t state;
 } cache_line_t;
 
+// most sectors a line can have: one bit each in sector_bits_t
+#define SECTOR_MAX 64
+
+// per-sector state of a sectored line, one bit per sector (see enable_sectors);
+// for MSI a valid sector is MODIFIED if its dirty bit is set, SHARED otherwise
 typedef struct {
+  unsigned long valid;
+  unsigned long dirty;
+} sector_bits_t;
+
+// how an address picks its set
+enum index_fn_t {
+  INDEX_MODULO,  // low-order block address bits (the default)
+  INDEX_XOR,     // all block address bits XOR-folded down to the index width
+  INDEX_PRIME,   // block address modulo the largest prime <= n_set
+  INDEX_SKEW     // skewed-associative: a different hash per way
+};
+
+// where a missed line is inserted in its set's replacement order
+enum insert_policy_t {
+  INSERT_MRU,  // most recently used, like a hit (the default)
+  INSERT_DIP   // set-dueling between MRU and bimodal (mostly next-victim) insertion
+};
+
+// set-dueling: one MRU and one bimodal leader set in every DUEL_SPACING sets,
+// a PSEL_BITS-wide saturating counter picks the followers' policy, and
+// bimodal insertion still inserts at MRU once every BIP_EPSILON fills
+#define DUEL_SPACING 32
+#define PSEL_BITS 10
+#define BIP_EPSILON 32
+
+typedef struct cache cache_t;
+
+// the protocol's access handler, chosen once in make_cache
+typedef bool (*access_fn_t)(cache_t *cache, unsigned long addr, enum action_t action);
+
+struct cache {
   int capacity;    // in Bytes
   int block_size;  // in Bytes
   int assoc;       // 1 for direct mapped, 2 for 2-way set associative, etc.
@@ -34,6 +81,13 @@ typedef struct {
   int n_index_bit;
   int n_tag_bit;
 
+  enum index_fn_t index_fn;
+  int n_prime_set;  // sets INDEX_PRIME uses
+
+  // precomputed from the geometry so the access path does not rebuild them
+  unsigned long index_mask;
+  unsigned long tag_mask;
+  int tag_shift;
 
   // cache lines stored in a 2D Array:
   // - 1st dimension = which set
@@ -45,17 +99,70 @@ typedef struct {
   // ignore this until you begin support for the n-way set associative cache
   int *lru_way;
 
+  // sectored lines: one tag per block, but data is fetched, written back
+  // and invalidated per sector. Unsectored caches have a single sector the
+  // size of the block and sectors == NULL.
+  int sector_size;  // in Bytes
+  int n_sector;
+  int n_sector_bit;
+  sector_bits_t **sectors;  // same shape as lines
+
   cache_stats_t *stats;
 
+  // per-set counts of core accesses and misses (NULL unless enable_set_histogram)
+  long *set_accesses;
+  long *set_misses;
+
+  // set and way touched by the most recent access, for verbose printing
+  int last_set;
+  int last_way;
+  bool last_upgrade_f;  // the most recent access was an MSI upgrade miss (S -> M)
+
+  // write buffer for simulated write-through traffic (NULL = estimate it instead)
+  write_buffer_t *wbuf;
+
+  // TLB translating this core's accesses (NULL = no translation simulated)
+  tlb_t *tlb;
+
+  // binary event log shared by all cores (NULL when not logging) and this cache's core
+  event_log_t *event_log;
+  int core_id;
+
   enum protocol_t protocol;
   bool lru_on_invalidate_f;
+
+  // handler used by access_cache, see select_access_fn
+  access_fn_t access_fn;
+
+  // adaptive insertion (see enable_adaptive_insertion): the policy, its
+  // dueling state, and a shadow copy of the cache using default insertion
+  // that sees the same accesses, for comparison
+  enum insert_policy_t insert_policy;
+  int psel;
+  long n_bip_fills;
+  long n_low_priority_fills;
+  access_fn_t insert_fn;  // the kernel access_fn wraps
+  cache_t *shadow;
 	
-} cache_t;
+};
 
 cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t protocol, bool lru_on_invalidate_f);
+void free_cache(cache_t *cache);
+bool valid_cache_geometry(int capacity, int block_size, int assoc);
+bool valid_sector_size(int block_size, int sector_size);
+void enable_asid_tags(cache_t *cache);
+int flush_cache(cache_t *cache);
+bool probe_cache(cache_t *cache, unsigned long addr);
+void set_index_function(cache_t *cache, enum index_fn_t index_fn);
+void enable_set_histogram(cache_t *cache);
+int enable_sectors(cache_t *cache, int sector_size);
+void enable_adaptive_insertion(cache_t *cache);
 unsigned long get_cache_tag(cache_t *cache, unsigned long addr);
 unsigned long get_cache_index(cache_t *cache, unsigned long addr);
 unsigned long get_cache_block_addr(cache_t *cache, unsigned long addr);
+unsigned long get_cache_sector_addr(cache_t *cache, unsigned long addr);
 bool access_cache(cache_t *cache, unsigned long addr, enum action_t action);
+int access_cache_batch(cache_t *cache, const unsigned long *addrs, const enum action_t *actions, int n,
+                       unsigned long *hit_bitmap);
 
 #endif  // CACHE
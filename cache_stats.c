@@ -19,6 +19,9 @@ cache_stats_t *make_cache_stats() {
   stats->n_snoop_hits = 0;
 
   stats->n_upgrade_miss = 0;
+
+  stats->n_context_switches = 0;
+  stats->n_switch_writebacks = 0;
   
   stats->hit_rate = 0.0;
 
@@ -30,6 +33,17 @@ cache_stats_t *make_cache_stats() {
   stats->B_total_traffic_wb = 0;
   stats->B_total_traffic_wt = 0;
 
+  stats->wt_simulated_f = false;
+  stats->n_wbuf_merges = 0;
+  stats->n_wbuf_flushes = 0;
+  stats->n_wbuf_snoop_flushes = 0;
+  stats->n_wbuf_stalls = 0;
+  stats->B_wbuf_written = 0;
+
+  stats->sector_size = 0;
+  stats->n_sector_fills = 0;
+  stats->n_sector_writebacks = 0;
+
   return stats;
 }
 
@@ -84,9 +98,19 @@ void calculate_stat_rates(cache_stats_t *stats, int block_size) {
   // miss count: number of accesses minus number of hits and upgrade misses: upgrade misses shouldn't generate traffic
   unsigned int n_misses = stats->n_cpu_accesses - stats->n_hits - stats->n_upgrade_miss;
 
-  stats->B_bus_to_cache = n_misses * block_size; // traffic into cache: miss count times block size
-  stats->B_cache_to_bus_wb = stats->n_writebacks * block_size; // directly multiply writeback count by bus size
-  stats->B_cache_to_bus_wt = stats->n_stores * 4; // assume that writethroughs always just write the current word back
+  if (stats->sector_size) {
+    // sectored lines move only the sectors they fetch or write back
+    stats->B_bus_to_cache = stats->n_sector_fills * stats->sector_size;
+    stats->B_cache_to_bus_wb = stats->n_sector_writebacks * stats->sector_size;
+  } else {
+    stats->B_bus_to_cache = n_misses * block_size; // traffic into cache: miss count times block size
+    stats->B_cache_to_bus_wb = stats->n_writebacks * block_size; // directly multiply writeback count by bus size
+  }
+  if (stats->wt_simulated_f) {
+    stats->B_cache_to_bus_wt = stats->B_wbuf_written; // what the write buffer actually flushed, after combining
+  } else {
+    stats->B_cache_to_bus_wt = stats->n_stores * 4; // assume that writethroughs always just write the current word back
+  }
   stats->B_total_traffic_wb = stats->B_bus_to_cache + stats->B_cache_to_bus_wb; // total writeback traffic is bus->cache plus writeback traffic
   stats->B_total_traffic_wt = stats->B_bus_to_cache + stats->B_cache_to_bus_wt; // total writethrough traffic is bus to cache plus writethrough traffic
 
@@ -16,6 +16,9 @@ typedef struct {
     long n_snoop_hits; // num times a bus event occurs for a valid line in your cache
     long n_upgrade_miss;
 
+    long n_context_switches;   // multiprogrammed runs only, see mix.h
+    long n_switch_writebacks;  // dirty lines written back when a switch flushed the cache
+
     double hit_rate;
 
     long B_bus_to_cache;  
@@ -26,6 +29,19 @@ typedef struct {
     long B_total_traffic_wb;  // write-back
     long B_total_traffic_wt;  // write-thru
 
+    // simulated write-through (see write_buffer.h); otherwise wt traffic is estimated
+    bool wt_simulated_f;
+    long n_wbuf_merges;         // stores combined into a block already buffered
+    long n_wbuf_flushes;        // buffer entries written to the bus
+    long n_wbuf_snoop_flushes;  // of those, flushed early because another core missed on the block
+    long n_wbuf_stalls;         // stores that found the buffer full and waited for a drain
+    long B_wbuf_written;        // bytes carried to the bus by the flushes
+
+    // sectored lines (see enable_sectors); traffic is then counted per sector
+    int sector_size;            // 0 unless the cache is sectored
+    long n_sector_fills;        // sectors fetched from the bus
+    long n_sector_writebacks;   // dirty sectors written back
+
 } cache_stats_t;
 
 cache_stats_t *make_cache_stats();
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "event_log.h"
+
+/* Creates the log file and writes its header.
+ * Returns NULL if the file cannot be written.
+ */
+event_log_t *open_event_log(const char *path, int block_size, int n_core, bool asid_f) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return NULL;
+  }
+
+  event_log_header_t header;
+  header.magic = EVENT_LOG_MAGIC;
+  header.version = EVENT_LOG_VERSION;
+  header.block_size = block_size;
+  header.n_core = n_core;
+  header.asid_f = asid_f;
+  if (fwrite(&header, sizeof(header), 1, file) != 1) {
+    fclose(file);
+    return NULL;
+  }
+
+  event_log_t *log = malloc(sizeof(event_log_t));
+  log->file = file;
+  log->buffer = malloc(EVENT_LOG_BUFFER_RECORDS * sizeof(event_record_t));
+  log->n_buffered = 0;
+  log->error_f = false;
+  return log;
+}
+
+/* Writes out every buffered record and flushes the file.
+ * Returns 0 on success, -1 if this or any earlier write failed.
+ */
+int flush_event_log(event_log_t *log) {
+  if (log->n_buffered > 0 &&
+      fwrite(log->buffer, sizeof(event_record_t), log->n_buffered, log->file) != (size_t)log->n_buffered) {
+    log->error_f = true;
+  }
+  log->n_buffered = 0;
+  if (fflush(log->file) != 0) {
+    log->error_f = true;
+  }
+  return log->error_f ? -1 : 0;
+}
+
+/* Flushes the remaining records, closes the file and frees the log.
+ * Returns 0 on success, -1 if any write to the file failed.
+ */
+int close_event_log(event_log_t *log) {
+  flush_event_log(log);
+  if (fclose(log->file) != 0) {
+    log->error_f = true;
+  }
+  int status = log->error_f ? -1 : 0;
+  free(log->buffer);
+  free(log);
+  return status;
+}
@@ -0,0 +1,76 @@
+#ifndef __EVENT_LOG_H
+#define __EVENT_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Compact binary log of every cache access and snoop, written instead of
+ * the per-access printf of verbose mode. The file is an event_log_header_t
+ * followed by event_record_t entries; decode it with p5_events.
+ */
+
+#define EVENT_LOG_MAGIC 0x56453550u  // "P5EV" in a little-endian file
+#define EVENT_LOG_VERSION 2
+
+// where -mix runs put the address space id, above the 32-bit address (see enable_asid_tags)
+#define EVENT_ASID_SHIFT 32
+
+// records buffered in memory before each write to the file
+#define EVENT_LOG_BUFFER_RECORDS 65536
+
+// bits of event_record_t.flags
+#define EVENT_HIT 0x1
+#define EVENT_WRITEBACK 0x2
+#define EVENT_UPGRADE_MISS 0x4
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t block_size;  // so the decoder can match addresses by block
+  uint32_t n_core;
+  uint32_t asid_f;      // records carry the ASID of a -mix process
+} event_log_header_t;
+
+typedef struct {
+  uint32_t addr;
+  uint32_t set;
+  uint16_t way;
+  uint8_t core;       // cache that handled the event
+  uint8_t action;     // enum action_t: LOAD/STORE from the core, LD_MISS/ST_MISS snooped
+  uint8_t old_state;  // enum state_t before the event
+  uint8_t new_state;  // enum state_t after the event
+  uint8_t flags;      // EVENT_* bits
+  uint8_t asid;       // address space id in -mix runs, 0 otherwise
+} event_record_t;
+
+typedef struct {
+  FILE *file;
+  event_record_t *buffer;
+  int n_buffered;
+  bool error_f;  // set if any write to the file failed
+} event_log_t;
+
+event_log_t *open_event_log(const char *path, int block_size, int n_core, bool asid_f);
+int close_event_log(event_log_t *log);
+int flush_event_log(event_log_t *log);
+
+/* Appends one record; only touches the file when the buffer fills up. */
+static inline void write_event(event_log_t *log, int core, unsigned long addr, int action, unsigned long set,
+                               int way, int old_state, int new_state, int flags) {
+  event_record_t *rec = &log->buffer[log->n_buffered++];
+  rec->addr = (uint32_t)addr;
+  rec->set = (uint32_t)set;
+  rec->way = (uint16_t)way;
+  rec->core = (uint8_t)core;
+  rec->action = (uint8_t)action;
+  rec->old_state = (uint8_t)old_state;
+  rec->new_state = (uint8_t)new_state;
+  rec->flags = (uint8_t)flags;
+  rec->asid = (uint8_t)(addr >> EVENT_ASID_SHIFT);
+  if (log->n_buffered == EVENT_LOG_BUFFER_RECORDS) {
+    flush_event_log(log);
+  }
+}
+
+#endif  // EVENT_LOG
@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "libp5.h"
+#include "cache.h"
+#include "cache_stats.h"
+#include "simulator.h"
+
+// longest trace record p5_feed_buffer accepts, including the newline
+#define MAX_RECORD_LEN 64
+
+// the handle callers get: the simulator stays private to the library
+struct p5 {
+  simulator_t *sim;
+};
+
+/* Copies a filled-in public struct to the caller's, which may be from an
+ * older or newer version: only the bytes both sizes cover are written, and
+ * the caller's size is kept.
+ * Returns 0 on success, -1 if out is NULL or its size is too small to hold
+ * even the size field.
+ */
+static int copy_out(void *out, const void *src, size_t src_size) {
+  if (out == NULL || *(size_t *)out < sizeof(size_t)) {
+    return -1;
+  }
+  size_t size = *(size_t *)out;
+  size_t n = (size < src_size) ? size : src_size;
+  memcpy((char *)out + sizeof(size_t), (const char *)src + sizeof(size_t), n - sizeof(size_t));
+  return 0;
+}
+
+/* Returns the P5_API_VERSION the library was built with. */
+int p5_api_version(void) {
+  return P5_API_VERSION;
+}
+
+/* Creates a simulator with the given configuration.
+ * Returns NULL if the configuration is invalid.
+ */
+p5_t *p5_create(const p5_config_t *config) {
+  if (config == NULL || config->size < sizeof(size_t)) {
+    return NULL;
+  }
+
+  // fields a caller built against an older header does not know stay zero
+  p5_config_t c;
+  memset(&c, 0, sizeof(c));
+  memcpy(&c, config, (config->size < sizeof(c)) ? config->size : sizeof(c));
+
+  if (c.protocol < P5_PROTOCOL_NONE || c.protocol > P5_PROTOCOL_MSI ||
+      c.index_fn < P5_INDEX_MODULO || c.index_fn > P5_INDEX_SKEW ||
+      c.insert_policy < P5_INSERT_MRU || c.insert_policy > P5_INSERT_DIP) {
+    return NULL;
+  }
+
+  simulator_t *sim = make_simulator();
+  sim->n_core = c.n_core;
+  sim->capacity = c.capacity;
+  sim->block_size = c.block_size;
+  sim->assoc = c.assoc;
+  sim->protocol = (c.protocol == P5_PROTOCOL_VI) ? VI : (c.protocol == P5_PROTOCOL_MSI) ? MSI : NONE;
+  sim->lru_on_invalidate_f = c.lru_on_invalidate_f != 0;
+  sim->write_buffer_entries = c.write_buffer_entries;
+  sim->write_buffer_drain_interval = c.write_buffer_drain_interval;
+  sim->llc_capacity = c.llc_capacity;
+  sim->llc_block_size = c.llc_block_size;
+  sim->llc_assoc = c.llc_assoc;
+  sim->llc_ucp_epoch = c.llc_ucp_epoch;
+  sim->index_fn = (c.index_fn == P5_INDEX_XOR) ? INDEX_XOR : (c.index_fn == P5_INDEX_PRIME) ? INDEX_PRIME :
+                  (c.index_fn == P5_INDEX_SKEW) ? INDEX_SKEW : INDEX_MODULO;
+  sim->set_histogram_f = c.set_histogram_f != 0;
+  sim->sector_size = c.sector_size;
+  sim->insert_policy = (c.insert_policy == P5_INSERT_DIP) ? INSERT_DIP : INSERT_MRU;
+  sim->tlb_entries = c.tlb_entries;
+  sim->tlb_assoc = c.tlb_assoc;
+  if (c.tlb_page_size != 0) {
+    sim->tlb_page_size = c.tlb_page_size;  // otherwise the simulator's 4K
+  }
+  sim->event_log_path = (char *)c.event_log_path;
+
+  if ((c.llc_masks && parse_llc_masks(sim, c.llc_masks) != 0) ||
+      (c.socket_map && parse_socket_map(sim, c.socket_map) != 0) ||
+      (c.core_config_path && load_core_config(sim, c.core_config_path) != 0) ||
+      setup_simulator(sim) != 0) {
+    free_simulator(sim);
+    return NULL;
+  }
+
+  p5_t *p5 = malloc(sizeof(p5_t));
+  p5->sim = sim;
+  return p5;
+}
+
+/* Simulates a single access; op is 'r' for a load and 'w' for a store.
+ * Returns 0 on success, -1 on a bad core or op.
+ */
+int p5_feed_record(p5_t *p5, int core, char op, unsigned long addr) {
+  if (op != 'r' && op != 'w') {
+    return -1;
+  }
+  return simulate_access(p5->sim, core, (op == 'r') ? LOAD : STORE, addr);
+}
+
+/* Simulates every record in buf, which holds len bytes in the trace file
+ * format ("<core> <r|w> <hex address>" per line). Blank lines are skipped.
+ * Returns the number of records simulated, or -1 at the first bad record
+ * (records before it have already been simulated).
+ */
+long p5_feed_buffer(p5_t *p5, const char *buf, size_t len) {
+  char record[MAX_RECORD_LEN];
+  size_t pos = 0;
+  long n_records = 0;
+
+  while (pos < len) {
+    const char *start = buf + pos;
+    const char *newline = memchr(start, '\n', len - pos);
+    size_t line_len = newline ? (size_t)(newline - start) : len - pos;
+    pos += line_len + (newline ? 1 : 0);
+
+    if (line_len == 0 || (line_len == 1 && start[0] == '\r')) {
+      continue;
+    }
+    if (line_len >= MAX_RECORD_LEN) {
+      return -1;
+    }
+    memcpy(record, start, line_len);
+    record[line_len] = '\0';
+
+    int core;
+    enum action_t action;
+    unsigned long addr;
+    if (!parse_trace_line(record, &core, &action, &addr) ||
+        simulate_access(p5->sim, core, action, addr) != 0) {
+      return -1;
+    }
+    n_records++;
+  }
+
+  return n_records;
+}
+
+// the public form of a cache's stats, with the rates computed
+static void export_stats(const cache_stats_t *stats, int block_size, p5_stats_t *out) {
+  cache_stats_t s = *stats;
+  calculate_stat_rates(&s, block_size);
+
+  out->size = sizeof(p5_stats_t);
+  out->n_cpu_accesses = s.n_cpu_accesses;
+  out->n_hits = s.n_hits;
+  out->n_stores = s.n_stores;
+  out->n_writebacks = s.n_writebacks;
+  out->n_bus_snoops = s.n_bus_snoops;
+  out->n_snoop_hits = s.n_snoop_hits;
+  out->n_upgrade_miss = s.n_upgrade_miss;
+  out->n_context_switches = s.n_context_switches;
+  out->n_switch_writebacks = s.n_switch_writebacks;
+  out->hit_rate = s.hit_rate;
+  out->B_bus_to_cache = s.B_bus_to_cache;
+  out->B_cache_to_bus_wb = s.B_cache_to_bus_wb;
+  out->B_cache_to_bus_wt = s.B_cache_to_bus_wt;
+  out->B_total_traffic_wb = s.B_total_traffic_wb;
+  out->B_total_traffic_wt = s.B_total_traffic_wt;
+  out->n_wbuf_merges = s.n_wbuf_merges;
+  out->n_wbuf_flushes = s.n_wbuf_flushes;
+  out->n_wbuf_snoop_flushes = s.n_wbuf_snoop_flushes;
+  out->n_wbuf_stalls = s.n_wbuf_stalls;
+  out->n_sector_fills = s.n_sector_fills;
+  out->n_sector_writebacks = s.n_sector_writebacks;
+}
+
+/* Copies the statistics of one core into out, with the rates computed.
+ * Returns 0 on success, -1 if the core does not exist or the event log
+ * could not be written.
+ */
+int p5_get_stats(p5_t *p5, int core, p5_stats_t *out) {
+  simulator_t *sim = p5->sim;
+  if (core < 0 || core >= sim->n_core) {
+    return -1;
+  }
+
+  // make sure queued accesses are reflected in the numbers (and in the event log)
+  finish_accesses(sim);
+  if (sim->event_log && flush_event_log(sim->event_log) != 0) {
+    return -1;
+  }
+
+  p5_stats_t stats;
+  export_stats(sim->cache[core]->stats, sim->cache[core]->block_size, &stats);
+  return copy_out(out, &stats, sizeof(stats));
+}
+
+/* Copies the statistics one core would have had with default MRU
+ * insertion, from the shadow cache kept under P5_INSERT_DIP.
+ * Returns 0 on success, -1 if the core does not exist or insert_policy is
+ * not P5_INSERT_DIP.
+ */
+int p5_get_default_insertion_stats(p5_t *p5, int core, p5_stats_t *out) {
+  simulator_t *sim = p5->sim;
+  if (core < 0 || core >= sim->n_core || sim->cache[core]->shadow == NULL) {
+    return -1;
+  }
+
+  finish_accesses(sim);
+  p5_stats_t stats;
+  export_stats(sim->cache[core]->shadow->stats, sim->cache[core]->block_size, &stats);
+  return copy_out(out, &stats, sizeof(stats));
+}
+
+/* Copies up to n per-set access and miss counts of one core (either array
+ * may be NULL). Returns the core's number of sets, or -1 if the core does
+ * not exist or set_histogram_f was off.
+ */
+int p5_get_set_counts(p5_t *p5, int core, int64_t *accesses, int64_t *misses, int n) {
+  simulator_t *sim = p5->sim;
+  if (core < 0 || core >= sim->n_core || sim->cache[core]->set_accesses == NULL) {
+    return -1;
+  }
+
+  finish_accesses(sim);
+  cache_t *cache = sim->cache[core];
+  for (int i = 0; i < n && i < cache->n_set; i++) {
+    if (accesses) accesses[i] = cache->set_accesses[i];
+    if (misses) misses[i] = cache->set_misses[i];
+  }
+  return cache->n_set;
+}
+
+/* Copies one core's view of the shared cache into out.
+ * Returns 0 on success, -1 if the core does not exist or there is no shared cache.
+ */
+int p5_get_llc_stats(p5_t *p5, int core, p5_llc_stats_t *out) {
+  simulator_t *sim = p5->sim;
+  if (sim->llc == NULL || core < 0 || core >= sim->n_core) {
+    return -1;
+  }
+
+  finish_accesses(sim);
+  llc_core_stats_t *s = &sim->llc->stats[core];
+  p5_llc_stats_t stats = { sizeof(stats), s->n_accesses, s->n_hits, s->n_writebacks, s->n_ways };
+  return copy_out(out, &stats, sizeof(stats));
+}
+
+/* Copies the TLB statistics of one core into out.
+ * Returns 0 on success, -1 if the core does not exist or has no TLB.
+ */
+int p5_get_tlb_stats(p5_t *p5, int core, p5_tlb_stats_t *out) {
+  simulator_t *sim = p5->sim;
+  if (core < 0 || core >= sim->n_core || sim->cache[core]->tlb == NULL) {
+    return -1;
+  }
+
+  finish_accesses(sim);
+  tlb_stats_t *s = &sim->cache[core]->tlb->stats;
+  p5_tlb_stats_t stats = { sizeof(stats), s->n_lookups, s->n_misses, s->n_walk_loads, s->n_walk_hits };
+  return copy_out(out, &stats, sizeof(stats));
+}
+
+/* Copies the coherence traffic of one socket into out.
+ * Returns 0 on success, -1 if there is no such socket or no socket map.
+ */
+int p5_get_socket_stats(p5_t *p5, int socket, p5_socket_stats_t *out) {
+  simulator_t *sim = p5->sim;
+  if (sim->socket_stats == NULL || socket < 0 || socket >= sim->n_socket) {
+    return -1;
+  }
+
+  finish_accesses(sim);
+  socket_stats_t *s = &sim->socket_stats[socket];
+  p5_socket_stats_t stats = { sizeof(stats), s->n_local_msgs, s->n_cross_msgs, s->B_local, s->B_cross, s->B_memory };
+  return copy_out(out, &stats, sizeof(stats));
+}
+
+/* Releases a simulator created by p5_create. */
+void p5_destroy(p5_t *p5) {
+  if (p5) {
+    free_simulator(p5->sim);
+    free(p5);
+  }
+}
@@ -0,0 +1,123 @@
+#ifndef __LIBP5_H
+#define __LIBP5_H
+
+/* Embeddable interface to the simulator (libp5.a / libp5.so).
+ *
+ * Everything lives in the p5_t returned by p5_create, so separate
+ * simulators can be used side by side, and no function here prints or
+ * exits: bad input is reported through the return value.
+ *
+ * The simulator's own structs are not part of this interface. The config
+ * and stats structs below belong to it and only ever grow at the end.
+ * Each one starts with its size: set it to sizeof the struct you were
+ * built against. The library then reads or fills only the fields both
+ * sides know. Config fields a caller does not know about take their
+ * defaults, and stats fields the library does not know about are left
+ * untouched.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// bumped whenever a field is appended to one of the structs below
+#define P5_API_VERSION 1
+
+typedef struct p5 p5_t;
+
+enum p5_protocol { P5_PROTOCOL_NONE = 0, P5_PROTOCOL_VI = 1, P5_PROTOCOL_MSI = 2 };
+enum p5_index_fn { P5_INDEX_MODULO = 0, P5_INDEX_XOR = 1, P5_INDEX_PRIME = 2, P5_INDEX_SKEW = 3 };
+enum p5_insert_policy { P5_INSERT_MRU = 0, P5_INSERT_DIP = 1 };
+
+// zero is the default for every field
+typedef struct {
+  size_t size;                       // sizeof(p5_config_t)
+  int32_t n_core;
+  int32_t capacity;                  // in Bytes, power of two
+  int32_t block_size;                // in Bytes, power of two
+  int32_t assoc;
+  int32_t protocol;                  // enum p5_protocol
+  int32_t lru_on_invalidate_f;
+  int32_t write_buffer_entries;      // simulate write-through with this many blocks buffered (0 = estimate)
+  int32_t write_buffer_drain_interval;  // accesses between background drains (0 = only when full)
+  const char *core_config_path;      // per-core cache config file, or NULL
+  int32_t llc_capacity;              // shared cache behind the cores' own, in Bytes (0 = none)
+  int32_t llc_block_size;
+  int32_t llc_assoc;
+  int32_t llc_ucp_epoch;             // utility-based repartitioning interval, 0 = off
+  const char *llc_masks;             // hex way mask per core, e.g. "f,f0", or NULL
+  int32_t index_fn;                  // enum p5_index_fn
+  int32_t set_histogram_f;           // count accesses and misses per set
+  int32_t sector_size;               // in Bytes, 0 for unsectored lines
+  int32_t insert_policy;             // enum p5_insert_policy
+  int32_t tlb_entries;               // per-core TLB size, 0 for no TLB
+  int32_t tlb_assoc;
+  int32_t tlb_page_size;             // in Bytes: 4K, 2M or 1G (0 = 4K)
+  const char *socket_map;            // socket of each core, e.g. "0,0,1,1", or NULL for one bus
+  const char *event_log_path;        // binary event log to write, or NULL for none
+} p5_config_t;
+
+// one core's cache, with the rates computed
+typedef struct {
+  size_t size;  // sizeof(p5_stats_t)
+  int64_t n_cpu_accesses;
+  int64_t n_hits;
+  int64_t n_stores;
+  int64_t n_writebacks;
+  int64_t n_bus_snoops;
+  int64_t n_snoop_hits;
+  int64_t n_upgrade_miss;
+  int64_t n_context_switches;
+  int64_t n_switch_writebacks;
+  double hit_rate;
+  int64_t B_bus_to_cache;
+  int64_t B_cache_to_bus_wb;
+  int64_t B_cache_to_bus_wt;
+  int64_t B_total_traffic_wb;
+  int64_t B_total_traffic_wt;
+  int64_t n_wbuf_merges;
+  int64_t n_wbuf_flushes;
+  int64_t n_wbuf_snoop_flushes;
+  int64_t n_wbuf_stalls;
+  int64_t n_sector_fills;
+  int64_t n_sector_writebacks;
+} p5_stats_t;
+
+// one core's share of the shared cache
+typedef struct {
+  size_t size;  // sizeof(p5_llc_stats_t)
+  int64_t n_accesses;
+  int64_t n_hits;
+  int64_t n_writebacks;
+  int64_t n_ways;
+} p5_llc_stats_t;
+
+typedef struct {
+  size_t size;  // sizeof(p5_tlb_stats_t)
+  int64_t n_lookups;
+  int64_t n_misses;
+  int64_t n_walk_loads;
+  int64_t n_walk_hits;
+} p5_tlb_stats_t;
+
+typedef struct {
+  size_t size;  // sizeof(p5_socket_stats_t)
+  int64_t n_local_msgs;
+  int64_t n_cross_msgs;
+  int64_t B_local;
+  int64_t B_cross;
+  int64_t B_memory;
+} p5_socket_stats_t;
+
+int p5_api_version(void);
+p5_t *p5_create(const p5_config_t *config);
+int p5_feed_record(p5_t *p5, int core, char op, unsigned long addr);
+long p5_feed_buffer(p5_t *p5, const char *buf, size_t len);
+int p5_get_stats(p5_t *p5, int core, p5_stats_t *out);
+int p5_get_default_insertion_stats(p5_t *p5, int core, p5_stats_t *out);
+int p5_get_set_counts(p5_t *p5, int core, int64_t *accesses, int64_t *misses, int n);
+int p5_get_llc_stats(p5_t *p5, int core, p5_llc_stats_t *out);
+int p5_get_tlb_stats(p5_t *p5, int core, p5_tlb_stats_t *out);
+int p5_get_socket_stats(p5_t *p5, int socket, p5_socket_stats_t *out);
+void p5_destroy(p5_t *p5);
+
+#endif  // LIBP5
@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include "llc.h"
+
+llc_t *make_llc(int capacity, int block_size, int assoc, int n_core) {
+  llc_t *llc = malloc(sizeof(llc_t));
+
+  llc->capacity = capacity;
+  llc->block_size = block_size;
+  llc->assoc = assoc;
+  llc->n_set = capacity / (block_size * assoc);
+  llc->n_offset_bit = log2(block_size);
+  llc->index_mask = (1UL << (int)log2(llc->n_set)) - 1;
+
+  llc->n_core = n_core;
+  // calloc leaves every line invalid
+  llc->lines = calloc(llc->n_set * assoc, sizeof(llc_line_t));
+  llc->clock = 0;
+
+  // unpartitioned: everyone may evict from every way
+  llc->way_mask = malloc(n_core * sizeof(unsigned long));
+  for (int c = 0; c < n_core; c++) {
+    llc->way_mask[c] = (assoc == LLC_MAX_ASSOC) ? ~0UL : (1UL << assoc) - 1;
+  }
+  llc->partitioned_f = false;
+
+  llc->ucp_epoch = 0;
+  llc->epoch_accesses = 0;
+  llc->n_repartitions = 0;
+  llc->n_sampled = 0;
+  llc->umon_tags = NULL;
+  llc->umon_hits = NULL;
+
+  llc->stats = calloc(n_core, sizeof(llc_core_stats_t));
+  for (int c = 0; c < n_core; c++) {
+    llc->stats[c].n_ways = assoc;
+  }
+
+  return llc;
+}
+
+void free_llc(llc_t *llc) {
+  free(llc->lines);
+  free(llc->way_mask);
+  free(llc->umon_tags);
+  free(llc->umon_hits);
+  free(llc->stats);
+  free(llc);
+}
+
+static int count_ways(unsigned long mask) {
+  int n = 0;
+  for (; mask; mask &= mask - 1) n++;
+  return n;
+}
+
+/* Installs a fixed way mask per core.
+ * Returns 0 on success, -1 if a mask is empty or names ways that do not exist.
+ */
+int llc_set_masks(llc_t *llc, const unsigned long *masks) {
+  unsigned long all = (llc->assoc == LLC_MAX_ASSOC) ? ~0UL : (1UL << llc->assoc) - 1;
+
+  for (int c = 0; c < llc->n_core; c++) {
+    if (masks[c] == 0 || (masks[c] & ~all) != 0) {
+      return -1;
+    }
+  }
+  for (int c = 0; c < llc->n_core; c++) {
+    llc->way_mask[c] = masks[c];
+    llc->stats[c].n_ways = count_ways(masks[c]);
+  }
+  llc->partitioned_f = true;
+  return 0;
+}
+
+/* Turns a number of ways per core into masks of contiguous ways, core 0 lowest. */
+static void apply_allocation(llc_t *llc, const int *alloc) {
+  int first = 0;
+  for (int c = 0; c < llc->n_core; c++) {
+    llc->way_mask[c] = ((alloc[c] == LLC_MAX_ASSOC) ? ~0UL : (1UL << alloc[c]) - 1) << first;
+    llc->stats[c].n_ways = alloc[c];
+    first += alloc[c];
+  }
+}
+
+/* Turns on utility-based partitioning, repartitioning every epoch accesses.
+ * Every core needs at least one way, so assoc must be at least n_core.
+ * Returns 0 on success, -1 otherwise.
+ */
+int llc_enable_ucp(llc_t *llc, int epoch) {
+  if (epoch <= 0 || llc->assoc < llc->n_core) {
+    return -1;
+  }
+
+  llc->ucp_epoch = epoch;
+  llc->n_sampled = (llc->n_set + UMON_SAMPLE_INTERVAL - 1) / UMON_SAMPLE_INTERVAL;
+  llc->umon_tags = calloc((size_t)llc->n_core * llc->n_sampled * llc->assoc, sizeof(unsigned long));
+  llc->umon_hits = calloc((size_t)llc->n_core * llc->assoc, sizeof(long));
+
+  // start from an even split until the monitors have something to say
+  int *alloc = malloc(llc->n_core * sizeof(int));
+  for (int c = 0; c < llc->n_core; c++) {
+    alloc[c] = llc->assoc / llc->n_core + (c < llc->assoc % llc->n_core ? 1 : 0);
+  }
+  apply_allocation(llc, alloc);
+  free(alloc);
+
+  llc->partitioned_f = true;
+  return 0;
+}
+
+/* Updates core's shadow LRU stack for a sampled set, as if it had the whole cache. */
+static void umon_access(llc_t *llc, int core, int sample, unsigned long block) {
+  unsigned long *stack = &llc->umon_tags[((size_t)core * llc->n_sampled + sample) * llc->assoc];
+  unsigned long key = block + 1;
+  int pos = llc->assoc - 1;  // not found: the LRU entry falls off
+
+  for (int p = 0; p < llc->assoc; p++) {
+    if (stack[p] == key) {
+      llc->umon_hits[core * llc->assoc + p]++;
+      pos = p;
+      break;
+    }
+  }
+
+  // move to the MRU position
+  for (int p = pos; p > 0; p--) {
+    stack[p] = stack[p - 1];
+  }
+  stack[0] = key;
+}
+
+// hits core would have had with n ways, according to its monitor
+static long umon_utility(llc_t *llc, int core, int n) {
+  long hits = 0;
+  for (int p = 0; p < n; p++) {
+    hits += llc->umon_hits[core * llc->assoc + p];
+  }
+  return hits;
+}
+
+/* Lookahead allocation: starting from one way each, repeatedly give the
+ * core with the highest hits-per-way gain (over any number of extra ways)
+ * those ways, until none are left. The monitors are then halved so old
+ * behaviour fades out.
+ */
+static void repartition(llc_t *llc) {
+  int *alloc = malloc(llc->n_core * sizeof(int));
+  int balance = llc->assoc - llc->n_core;
+
+  for (int c = 0; c < llc->n_core; c++) {
+    alloc[c] = 1;
+  }
+
+  while (balance > 0) {
+    double best_gain = -1.0;
+    int best_core = 0, best_ways = 1;
+
+    for (int c = 0; c < llc->n_core; c++) {
+      long base = umon_utility(llc, c, alloc[c]);
+      for (int k = 1; k <= balance; k++) {
+        double gain = (umon_utility(llc, c, alloc[c] + k) - base) / (double)k;
+        if (gain > best_gain) {
+          best_gain = gain;
+          best_core = c;
+          best_ways = k;
+        }
+      }
+    }
+
+    alloc[best_core] += best_ways;
+    balance -= best_ways;
+  }
+
+  apply_allocation(llc, alloc);
+  free(alloc);
+
+  for (int i = 0; i < llc->n_core * llc->assoc; i++) {
+    llc->umon_hits[i] /= 2;
+  }
+  llc->n_repartitions++;
+}
+
+/* Looks up the block of addr for core, filling it on a miss from the
+ * core's allowed ways. store_f marks the line dirty. Returns true on a hit.
+ */
+bool llc_access(llc_t *llc, int core, unsigned long addr, bool store_f) {
+  unsigned long block = addr >> llc->n_offset_bit;
+  unsigned long index = block & llc->index_mask;
+  llc_line_t *set = &llc->lines[index * llc->assoc];
+  llc_line_t *victim = NULL;
+
+  llc->clock++;
+  llc->stats[core].n_accesses++;
+
+  if (llc->ucp_epoch > 0) {
+    if (index % UMON_SAMPLE_INTERVAL == 0) {
+      umon_access(llc, core, index / UMON_SAMPLE_INTERVAL, block);
+    }
+    if (++llc->epoch_accesses == llc->ucp_epoch) {
+      llc->epoch_accesses = 0;
+      repartition(llc);
+    }
+  }
+
+  for (int w = 0; w < llc->assoc; w++) {
+    if (set[w].valid_f && set[w].tag == block) {
+      set[w].last_use = llc->clock;
+      set[w].dirty_f |= store_f;
+      llc->stats[core].n_hits++;
+      return true;
+    }
+  }
+
+  // miss: evict the least recently used line among the core's ways, preferring empty ones
+  for (int w = 0; w < llc->assoc; w++) {
+    if (!(llc->way_mask[core] & (1UL << w))) continue;
+    if (victim == NULL || (victim->valid_f && (!set[w].valid_f || set[w].last_use < victim->last_use))) {
+      victim = &set[w];
+    }
+  }
+
+  if (victim->valid_f && victim->dirty_f) {
+    llc->stats[victim->owner].n_writebacks++;
+  }
+  victim->tag = block;
+  victim->valid_f = true;
+  victim->dirty_f = store_f;
+  victim->last_use = llc->clock;
+  victim->owner = core;
+  return false;
+}
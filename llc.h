@@ -0,0 +1,70 @@
+#ifndef __LLC_H
+#define __LLC_H
+
+#include <stdbool.h>
+
+/* Shared last-level cache behind the private per-core caches, with
+ * way-partitioning for QoS.
+ *
+ * Every access that misses in a core's own cache (and needs data) is
+ * looked up here on behalf of that core. Replacement is LRU, but a core
+ * only ever evicts from the ways in its way mask; hits may land in any
+ * way. Masks are either fixed (llc_set_masks) or recomputed every epoch by
+ * utility-based partitioning (llc_enable_ucp): per-core shadow tags
+ * (UMON) on a sample of the sets count how many hits each core would get
+ * with each number of ways, and the ways go to the cores that gain the
+ * most from them.
+ */
+
+#define UMON_SAMPLE_INTERVAL 32  // every 32nd set carries shadow tags
+#define LLC_MAX_ASSOC 64         // way masks are one unsigned long
+
+typedef struct {
+  unsigned long tag;  // whole block number
+  bool valid_f;
+  bool dirty_f;
+  long last_use;  // for LRU
+  int owner;      // core that brought the line in
+} llc_line_t;
+
+typedef struct {
+  long n_accesses;
+  long n_hits;
+  long n_writebacks;  // dirty lines of this core's evicted from the llc
+  int n_ways;         // ways in the core's current mask
+} llc_core_stats_t;
+
+typedef struct {
+  int capacity;    // in Bytes
+  int block_size;  // in Bytes
+  int assoc;
+  int n_set;
+  int n_offset_bit;
+  unsigned long index_mask;
+
+  int n_core;
+  llc_line_t *lines;  // n_set rows of assoc lines
+  long clock;         // access counter, stamps last_use
+
+  // way partitioning: a mask per core, all ways when unpartitioned
+  unsigned long *way_mask;
+  bool partitioned_f;
+
+  // utility-based partitioning, when ucp_epoch > 0
+  int ucp_epoch;  // llc accesses between repartitions
+  long epoch_accesses;
+  long n_repartitions;
+  int n_sampled;             // sets carrying shadow tags
+  unsigned long *umon_tags;  // [core][sampled set][stack position], block number + 1, 0 = empty
+  long *umon_hits;           // [core][stack position]: hits the core got at that LRU depth
+
+  llc_core_stats_t *stats;  // per core
+} llc_t;
+
+llc_t *make_llc(int capacity, int block_size, int assoc, int n_core);
+void free_llc(llc_t *llc);
+int llc_set_masks(llc_t *llc, const unsigned long *masks);
+int llc_enable_ucp(llc_t *llc, int epoch);
+bool llc_access(llc_t *llc, int core, unsigned long addr, bool store_f);
+
+#endif  // LLC
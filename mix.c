@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mix.h"
+#include "print_helpers.h"
+
+/* Reads the next record of a process.
+ * Returns 1 for a record, 0 once its trace is exhausted, or -1 if the
+ * trace turns out to be malformed (which is reported).
+ */
+static int next_record(mix_process_t *proc, char **line, size_t *len, enum action_t *action,
+        unsigned long *addr) {
+    int core;
+
+    while (getline(line, len, proc->file) != -1) {
+        if (parse_trace_line(*line, &core, action, addr)) {
+            return 1;
+        }
+        // tolerate blank lines, but nothing else
+        if ((*line)[0] != '\n' && (*line)[0] != '\0') {
+            printf("ERROR: malformed line in %s: %s", proc->trace, *line);
+            proc->done_f = true;
+            return -1;
+        }
+    }
+    proc->done_f = true;
+    return 0;
+}
+
+/* Run queues: one shared queue when migrating, otherwise one per core.
+ * Each is a ring of process ids, big enough to hold every process.
+ */
+typedef struct {
+    int n_proc;
+    int *ids;    // queue q's ring is ids[q * n_proc ..]
+    int *head;
+    int *count;
+} run_queues_t;
+
+static void enqueue(run_queues_t *rq, int q, int p) {
+    rq->ids[q * rq->n_proc + (rq->head[q] + rq->count[q]) % rq->n_proc] = p;
+    rq->count[q]++;
+}
+
+// returns the next waiting process of queue q, or -1 if there is none
+static int dequeue(run_queues_t *rq, int q) {
+    if (rq->count[q] == 0) {
+        return -1;
+    }
+    int p = rq->ids[q * rq->n_proc + rq->head[q]];
+    rq->head[q] = (rq->head[q] + 1) % rq->n_proc;
+    rq->count[q]--;
+    return p;
+}
+
+// puts process p on core, counting the context switch and the migration
+static void switch_to(simulator_t *sim, mix_process_t *procs, int *last_proc, int core, int p) {
+    if (last_proc[core] != -1 && last_proc[core] != p) {
+        sim->cache[core]->stats->n_context_switches++;
+        if (!sim->asid_f) {
+            finish_accesses(sim);
+            flush_cache(sim->cache[core]);
+            if (sim->cache[core]->tlb) flush_tlb(sim->cache[core]->tlb);
+        }
+    }
+    if (procs[p].last_core != -1 && procs[p].last_core != core) {
+        procs[p].n_migrations++;
+    }
+    last_proc[core] = p;
+    procs[p].last_core = core;
+}
+
+/*
+ * Schedules the mixed traces onto the cores and simulates them.
+ * Returns 0 on success, -1 if a trace cannot be opened or is malformed.
+ */
+int process_mix(simulator_t *sim) {
+    int n_proc = sim->n_mix;
+    int i, core;
+    int status = 0;
+    char *line = NULL;
+    size_t len = 0;
+
+    printf("Processing mix of %d traces...\n", n_proc);
+    printf("%d %d\n", sim->n_core, sim->protocol);
+
+    mix_process_t *procs = malloc(n_proc * sizeof(mix_process_t));
+    for (i = 0; i < n_proc; i++) {
+        procs[i].trace = sim->mix_traces[i];
+        procs[i].file = open_trace(procs[i].trace);
+        procs[i].asid = i;
+        procs[i].done_f = false;
+        procs[i].last_core = -1;
+        procs[i].n_accesses = 0;
+        procs[i].n_hits = 0;
+        procs[i].n_migrations = 0;
+        if (procs[i].file == NULL) {
+            printf("File \'%s\' not found\n", procs[i].trace);
+            status = -1;
+        }
+    }
+
+    int n_queue = sim->migrate_f ? 1 : sim->n_core;
+    run_queues_t rq;
+    rq.n_proc = n_proc;
+    rq.ids = malloc(n_queue * n_proc * sizeof(int));
+    rq.head = calloc(n_queue, sizeof(int));
+    rq.count = calloc(n_queue, sizeof(int));
+    for (i = 0; i < n_proc; i++) {
+        enqueue(&rq, sim->migrate_f ? 0 : i % sim->n_core, i);
+    }
+
+    int *running = malloc(sim->n_core * sizeof(int));    // process on each core this quantum, -1 if idle
+    int *last_proc = malloc(sim->n_core * sizeof(int));  // process the core ran last, -1 if none yet
+    for (core = 0; core < sim->n_core; core++) {
+        last_proc[core] = -1;
+    }
+
+    bool limit_reached_f = false;
+    while (status == 0 && !limit_reached_f) {
+        bool any_running_f = false;
+
+        // start of a quantum: every core takes the next waiting process
+        for (core = 0; core < sim->n_core; core++) {
+            int p = dequeue(&rq, sim->migrate_f ? 0 : core);
+            running[core] = p;
+            if (p == -1) continue;
+
+            any_running_f = true;
+            switch_to(sim, procs, last_proc, core, p);
+        }
+
+        if (!any_running_f) break;
+
+        // run the quantum, interleaving the cores one access at a time
+        for (int step = 0; step < sim->quantum && !limit_reached_f && status == 0; step++) {
+            bool progress_f = false;
+            for (core = 0; core < sim->n_core; core++) {
+                int p = running[core];
+                enum action_t action;
+                unsigned long addr;
+
+                if (p == -1 || procs[p].done_f) continue;
+                if (sim->limit_insn_f && sim->total_insn == sim->insn_limit) {
+                    printf("Reached insn limit of %d. Ending Simulation...\n", sim->insn_limit);
+                    limit_reached_f = true;
+                    break;
+                }
+                int got = next_record(&procs[p], &line, &len, &action, &addr);
+                while (got == 0 && (p = dequeue(&rq, sim->migrate_f ? 0 : core)) != -1) {
+                    // finished early: the core takes the next waiting process rather than idle
+                    running[core] = p;
+                    switch_to(sim, procs, last_proc, core, p);
+                    got = next_record(&procs[p], &line, &len, &action, &addr);
+                }
+                if (got < 0) {
+                    status = -1;
+                    break;
+                }
+                if (got == 0) {
+                    running[core] = -1;
+                    continue;
+                }
+
+                // the ASID goes above the address, where enable_asid_tags widened the tag
+                addr |= (unsigned long)procs[p].asid << ADDRESS_SIZE;
+                procs[p].n_accesses++;
+                if (simulate_access_now(sim, core, action, addr)) {
+                    procs[p].n_hits++;
+                }
+                progress_f = true;
+            }
+            if (!progress_f) break;
+        }
+
+        // end of the quantum: unfinished processes wait for their next turn
+        for (core = 0; core < sim->n_core; core++) {
+            int p = running[core];
+            if (p == -1 || procs[p].done_f) continue;
+            enqueue(&rq, sim->migrate_f ? 0 : core, p);
+        }
+    }
+
+    finish_accesses(sim);
+    if (sim->event_log && flush_event_log(sim->event_log) != 0) {
+        printf("ERROR: could not write the event log %s\n", sim->event_log_path);
+        status = -1;
+    }
+
+    if (status == 0) {
+        printf("Processed %ld lines.\n", sim->total_insn);
+        report_results(sim);
+
+        printf("    *** Multiprogramming ***\n");
+        for (core = 0; core < sim->n_core; core++) {
+            printf("%d.n_context_switches \t%ld\n", core, sim->cache[core]->stats->n_context_switches);
+            printf("%d.n_switch_writebacks \t%ld\n", core, sim->cache[core]->stats->n_switch_writebacks);
+        }
+        for (i = 0; i < n_proc; i++) {
+            printf("P%d.trace \t\t%s\n", i, procs[i].trace);
+            printf("P%d.n_accesses \t\t%ld\n", i, procs[i].n_accesses);
+            printf("P%d.hit_rate \t\t%.2f\n", i,
+                    procs[i].n_accesses ? 100.0 * procs[i].n_hits / procs[i].n_accesses : 0.0);
+            printf("P%d.n_migrations \t%ld\n", i, procs[i].n_migrations);
+        }
+    }
+
+    for (i = 0; i < n_proc; i++) {
+        if (procs[i].file) fclose(procs[i].file);
+    }
+    free(procs);
+    free(rq.ids);
+    free(rq.head);
+    free(rq.count);
+    free(running);
+    free(last_proc);
+    if (line) free(line);
+
+    return status;
+}
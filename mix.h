@@ -0,0 +1,35 @@
+#ifndef __MIX_H
+#define __MIX_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "simulator.h"
+
+/* Multiprogrammed simulation: sim->n_mix independent single-thread traces
+ * (the core field of their records is ignored) run as processes on
+ * sim->n_core cores. Every sim->quantum accesses each core switches to the
+ * next waiting process, either from its own queue (pinned) or from one
+ * shared queue (sim->migrate_f). A core whose process finishes mid-quantum
+ * takes the next waiting one right away. Cores take turns issuing one
+ * access each, like the threads of a multi-threaded trace.
+ *
+ * Each process gets its own address space id. Without sim->asid_f a
+ * context switch flushes the core's cache; with it, lines stay tagged with
+ * their process and simply compete for space.
+ */
+
+typedef struct {
+  char *trace;
+  FILE *file;
+  int asid;
+  bool done_f;  // trace exhausted
+
+  int last_core;  // -1 before it first runs
+  long n_accesses;
+  long n_hits;
+  long n_migrations;
+} mix_process_t;
+
+int process_mix(simulator_t *sim);
+
+#endif  // MIX
@@ -4,10 +4,7 @@
 
 #include "print_helpers.h"
 #include "simulator.h"
-
-int capacity;
-int block_size;
-int assoc;
+#include "mix.h"
 
 void printUsage() {
     printf("\nUsage: ./p5 [-hv] -t <tracename> -l <limit> -n_cores <n> -cache <cap> <bsize> <assoc>\n");
@@ -17,15 +14,42 @@ void printUsage() {
     printf("  -n|n_core <n>                  How many cores to simulate\n");
     printf("  -c|cache <cap> <bsize> <assoc>  Set the cache configuration. <cap> "
             "and <bsize> are given as the log of the value.\n");
+    printf("  -f|config <file>                Per-core cache configuration; each line is\n");
+    printf("                                  <core> <cap> <bsize> <assoc> [lru_on_invalidate]\n");
+    printf("                                  Unlisted cores use -cache\n");
     printf("  -p|protocol none|vi|msi         which coherence protocol\n");
     printf("  -t|trace <tracename>            Name of trace \n");
-    printf("  -i|lru_on_invalidate            update LRU on line invalidation\n");
+    printf("  -llc <cap> <bsize> <assoc>      Add a cache shared by all cores behind the private ones\n");
+    printf("  -llc_masks <m0,m1,...>          Hex way mask per core for the shared cache\n");
+    printf("  -llc_ucp <epoch>                Utility-based repartitioning every epoch accesses\n");
+    printf("  -x|index modulo|xor|prime|skew  Set index function (default modulo)\n");
+    printf("  -set_histogram                  Report how accesses spread over the sets\n");
+    printf("  -sector <log sector size>       Sectored lines: fetch and invalidate per sector\n");
+    printf("  -insert mru|dip                 Miss insertion policy (default mru); dip reports\n");
+    printf("                                  its gain over mru\n");
+    printf("  -tlb <n> <assoc> <4K|2M|1G>     Per-core n-entry TLB; misses walk the page\n");
+    printf("                                  table through the data cache\n");
+    printf("  -s|sockets <s0,s1,...>          Socket of each core, e.g. 0,0,1,1; each socket\n");
+    printf("                                  snoops locally and forwards over a link\n");
+    printf("  -m|mix <t1,t2,...>              Run these single-thread traces as separate\n");
+    printf("                                  processes scheduled onto the cores\n");
+    printf("  -q|quantum <n>                  Accesses per time slice with -mix (default 10000)\n");
+    printf("  -migrate                        Let -mix processes move between cores\n");
+    printf("  -asid                           ASID-tag lines instead of flushing on a switch\n");
+    printf("  -i|lru_on_invalidate            a line invalidated by a snoop becomes the next victim\n");
     printf("  -l|limit <n>                    Simulate only first n insns \n");
+    printf("  -w|write_buffer <n> <drain>     Simulate write-through with an n-block write\n");
+    printf("                                  buffer, draining one entry every <drain>\n");
+    printf("                                  accesses (0 = only when full)\n");
+    printf("  -e|event_log <file>             Write a binary log of every access and snoop\n");
+    printf("                                  (decode with ./p5_events)\n");
     printf("\nExamples:\n");
     printf("  shell>  ./p5 -t route.1t.short.txt -cache 9 5 1 \n");
     printf("  shell>  ./p5 -t route.1t.short.txt -cache 12 6 2 \n");
     printf("  shell>  ./p5 -t route.1t.short.txt -cache 16 4 2 \n");
     printf("  shell>  ./p5 -t route.1t.long.txt -cache 16 4 2 -limit 500\n");
+    printf("  shell>  ./p5 -n 2 -mix trace.1t.long.txt,trace.1t.long.txt,trace.1t.short.txt "
+            "-quantum 5000 -migrate -cache 15 6 4\n");
     printf(
             "  -cache 9 5 1   Creates a direct mapped cache "
             "with a capacity of 512B and block size of 32B \n");
@@ -41,15 +65,40 @@ void suggest_help(){
     printf("Need help? try shell>  ./p5 -help\n");
 }
 
+/*
+ * Configures the simulator from the command line.
+ * Returns 1 to run the simulation, 0 if only help was requested, and -1 on
+ * invalid arguments (after printing what was wrong).
+ */
 int parse_args(char **args, int num_args, simulator_t *sim) {
     int i = 0;
     char *arg;
     bool cache_specified = false;
+    char *config_path = NULL;
 
     // use the command line arguments to customize the simulator each run
     while (i < num_args) {
         arg = args[i++];
 
+        // every option below except the flags takes at least one value
+        if (i == num_args && arg[0] == '-' &&
+                (strcmp(arg, "-n_core") == 0 || strcmp(arg, "-n") == 0 ||
+                 strcmp(arg, "-protocol") == 0 || strcmp(arg, "-p") == 0 ||
+                 strcmp(arg, "-trace") == 0 || strcmp(arg, "-t") == 0 ||
+                 strcmp(arg, "-limit") == 0 || strcmp(arg, "-l") == 0 ||
+                 strcmp(arg, "-event_log") == 0 || strcmp(arg, "-e") == 0 ||
+                 strcmp(arg, "-config") == 0 || strcmp(arg, "-f") == 0 ||
+                 strcmp(arg, "-mix") == 0 || strcmp(arg, "-m") == 0 ||
+                 strcmp(arg, "-quantum") == 0 || strcmp(arg, "-q") == 0 ||
+                 strcmp(arg, "-sockets") == 0 || strcmp(arg, "-s") == 0 ||
+                 strcmp(arg, "-index") == 0 || strcmp(arg, "-x") == 0 ||
+                 strcmp(arg, "-llc_masks") == 0 || strcmp(arg, "-llc_ucp") == 0 ||
+                 strcmp(arg, "-sector") == 0 || strcmp(arg, "-insert") == 0)) {
+            printf("Option %s requires a value.\nExiting...\n", arg);
+            suggest_help();
+            return -1;
+        }
+
         // -help
         if (strcmp(arg, "-help") == 0 || strcmp(arg, "-h") == 0) {
             printUsage();
@@ -73,32 +122,37 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
                 printf("Cache description incomplete. Capacity, block size, "
                         "and associativity must be specified.\nExiting...\n");
                 suggest_help();
-                exit(1);
+                return -1;
             }
             int log_cap = atoi(args[i++]);
-            capacity = 1 << log_cap;
+            sim->capacity = 1 << log_cap;
             int log_block_size = atoi(args[i++]);
-            block_size = 1 << log_block_size;
-            assoc = atoi(args[i++]);
+            sim->block_size = 1 << log_block_size;
+            sim->assoc = atoi(args[i++]);
             if (log_cap > 25 || log_cap < 0 || log_block_size > 25 ||
-                    log_block_size < 0 || assoc == 0) {
+                    log_block_size < 0 || sim->assoc <= 0) {
                 printf(
                         "Cache description invalid. Capacity and block size must be "
                         "between 2^0 and 2^25. Associativity must be "
                         "non-zero.\nExiting...\n");
                 suggest_help();
-                exit(1);
+                return -1;
             }
-            if (capacity / block_size / assoc == 0) {
+            if (sim->capacity / sim->block_size / sim->assoc == 0) {
                 printf(
                         "Cache description invalid. Associativity or block size too high "
                         "for given capacity.\nExiting...\n");
                 suggest_help();
-                exit(1);
+                return -1;
             }
             cache_specified = true;
         }
 
+        // -config cores.cfg
+        if (strcmp(arg, "-config") == 0 || strcmp(arg, "-f") == 0) {
+            config_path = args[i++];
+        }
+
         // -protocol none|vi|msi
         if (strcmp(arg, "-protocol") == 0 || strcmp(arg, "-p") == 0) {
             char *protocol = args[i++];
@@ -111,7 +165,7 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
             else {
                 printf("unsupported cohorence protocol.\nExiting....\n");
                 suggest_help();
-                exit(1);
+                return -1;
             }
         }
 
@@ -120,6 +174,164 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
             sim->trace = args[i++];
         }
 
+        // -llc C B A
+        if (strcmp(arg, "-llc") == 0) {
+            if (i + 3 > num_args) {
+                printf("Shared cache description incomplete. Capacity, block size, "
+                        "and associativity must be specified.\nExiting...\n");
+                suggest_help();
+                return -1;
+            }
+            int log_cap = atoi(args[i++]);
+            int log_block_size = atoi(args[i++]);
+            sim->llc_assoc = atoi(args[i++]);
+            if (log_cap > 30 || log_cap < 0 || log_block_size > 25 || log_block_size < 0 ||
+                    sim->llc_assoc <= 0 || sim->llc_assoc > LLC_MAX_ASSOC ||
+                    (1 << log_cap) / (1 << log_block_size) / sim->llc_assoc == 0) {
+                printf("Shared cache description invalid. Associativity must be between 1 and "
+                        "%d and fit the capacity.\nExiting...\n", LLC_MAX_ASSOC);
+                suggest_help();
+                return -1;
+            }
+            sim->llc_capacity = 1 << log_cap;
+            sim->llc_block_size = 1 << log_block_size;
+        }
+
+        // -llc_masks f,f0
+        if (strcmp(arg, "-llc_masks") == 0) {
+            if (parse_llc_masks(sim, args[i++]) != 0) {
+                printf("Way masks invalid. Give a hex mask per core, separated by commas.\nExiting...\n");
+                suggest_help();
+                return -1;
+            }
+        }
+
+        // -llc_ucp 100000
+        if (strcmp(arg, "-llc_ucp") == 0) {
+            sim->llc_ucp_epoch = atoi(args[i++]);
+            if (sim->llc_ucp_epoch <= 0) {
+                printf("Repartitioning epoch must be positive.\nExiting...\n");
+                suggest_help();
+                return -1;
+            }
+        }
+
+        // -index modulo|xor|prime|skew
+        if (strcmp(arg, "-index") == 0 || strcmp(arg, "-x") == 0) {
+            char *index_fn = args[i++];
+            if (strcmp(index_fn, "modulo") == 0)
+                sim->index_fn = INDEX_MODULO;
+            else if (strcmp(index_fn, "xor") == 0)
+                sim->index_fn = INDEX_XOR;
+            else if (strcmp(index_fn, "prime") == 0)
+                sim->index_fn = INDEX_PRIME;
+            else if (strcmp(index_fn, "skew") == 0)
+                sim->index_fn = INDEX_SKEW;
+            else {
+                printf("unsupported index function.\nExiting....\n");
+                suggest_help();
+                return -1;
+            }
+        }
+
+        // -set_histogram
+        if (strcmp(arg, "-set_histogram") == 0) {
+            sim->set_histogram_f = true;
+        }
+
+        // -insert mru|dip
+        if (strcmp(arg, "-insert") == 0) {
+            char *policy = args[i++];
+            if (strcmp(policy, "mru") == 0)
+                sim->insert_policy = INSERT_MRU;
+            else if (strcmp(policy, "dip") == 0)
+                sim->insert_policy = INSERT_DIP;
+            else {
+                printf("unsupported insertion policy.\nExiting....\n");
+                suggest_help();
+                return -1;
+            }
+        }
+
+        // -sector 4
+        if (strcmp(arg, "-sector") == 0) {
+            int log_sector_size = atoi(args[i++]);
+            if (log_sector_size < 0 || log_sector_size > 25) {
+                printf("Sector size invalid.\nExiting...\n");
+                suggest_help();
+                return -1;
+            }
+            sim->sector_size = 1 << log_sector_size;
+        }
+
+        // -tlb 64 4 4K
+        if (strcmp(arg, "-tlb") == 0) {
+            if (i + 3 > num_args) {
+                printf("TLB description incomplete. Entries, associativity and page size "
+                        "must be specified.\nExiting...\n");
+                suggest_help();
+                return -1;
+            }
+            sim->tlb_entries = atoi(args[i++]);
+            sim->tlb_assoc = atoi(args[i++]);
+            char *page = args[i++];
+            sim->tlb_page_size = (strcmp(page, "4K") == 0) ? 1 << 12 :
+                                 (strcmp(page, "2M") == 0) ? 1 << 21 :
+                                 (strcmp(page, "1G") == 0) ? 1 << 30 : 0;
+            if (!valid_tlb_geometry(sim->tlb_entries, sim->tlb_assoc, sim->tlb_page_size)) {
+                printf("TLB description invalid. Page size must be 4K, 2M or 1G and the "
+                        "entries a multiple of the associativity.\nExiting...\n");
+                suggest_help();
+                return -1;
+            }
+        }
+
+        // -sockets 0,0,1,1
+        if (strcmp(arg, "-sockets") == 0 || strcmp(arg, "-s") == 0) {
+            if (parse_socket_map(sim, args[i++]) != 0) {
+                printf("Socket map invalid. Give a socket id (0-255) per core, separated by "
+                        "commas.\nExiting...\n");
+                suggest_help();
+                return -1;
+            }
+        }
+
+        // -mix a.txt,b.txt,c.txt
+        if (strcmp(arg, "-mix") == 0 || strcmp(arg, "-m") == 0) {
+            char *list = args[i++];
+            free(sim->mix_traces);
+            sim->n_mix = 0;
+            sim->mix_traces = malloc((strlen(list) / 2 + 1) * sizeof(char *));
+            for (char *name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+                sim->mix_traces[sim->n_mix++] = name;
+            }
+            if (sim->n_mix == 0 || sim->n_mix > (1 << ASID_BITS)) {
+                printf("A mix needs between 1 and %d traces.\nExiting...\n", 1 << ASID_BITS);
+                suggest_help();
+                return -1;
+            }
+        }
+
+        // -quantum 10000
+        if (strcmp(arg, "-quantum") == 0 || strcmp(arg, "-q") == 0) {
+            sim->quantum = atoi(args[i++]);
+            if (sim->quantum <= 0) {
+                printf("Quantum must be positive.\nExiting...\n");
+                suggest_help();
+                return -1;
+            }
+        }
+
+        // -migrate
+        if (strcmp(arg, "-migrate") == 0) {
+            sim->migrate_f = true;
+        }
+
+        // -asid
+        if (strcmp(arg, "-asid") == 0) {
+            sim->asid_f = true;
+        }
+
         // -lru_on_invalidate
         if (strcmp(arg, "-lru_on_invalidate") == 0 || strcmp(arg, "-i") == 0) {
             sim->lru_on_invalidate_f = true;
@@ -130,12 +342,87 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
             sim->limit_insn_f = true;
             sim->insn_limit = atoi(args[i++]);
         }
+
+        // -write_buffer N D
+        if (strcmp(arg, "-write_buffer") == 0 || strcmp(arg, "-w") == 0) {
+            if (i + 2 > num_args) {
+                printf("Write buffer description incomplete. Number of entries and drain "
+                        "interval must be specified.\nExiting...\n");
+                suggest_help();
+                return -1;
+            }
+            sim->write_buffer_entries = atoi(args[i++]);
+            sim->write_buffer_drain_interval = atoi(args[i++]);
+            if (sim->write_buffer_entries <= 0 || sim->write_buffer_drain_interval < 0) {
+                printf("Write buffer description invalid. It needs at least one entry and a "
+                        "non-negative drain interval.\nExiting...\n");
+                suggest_help();
+                return -1;
+            }
+        }
+
+        // -event_log events.bin
+        if (strcmp(arg, "-event_log") == 0 || strcmp(arg, "-e") == 0) {
+            sim->event_log_path = args[i++];
+        }
+    }
+
+    if (!cache_specified && config_path == NULL) {
+        printf("No cache description specified. Please use the -cache or -config flag\n");
+        suggest_help();
+        return -1;
     }
 
-    if (!cache_specified) {
-        printf("No cache description specified. Please use the -cache flag\n");
+    if (sim->socket_of && sim->n_socket_map != sim->n_core) {
+        printf("Socket map lists %d cores, but there are %d.\nExiting...\n", sim->n_socket_map, sim->n_core);
         suggest_help();
-        exit(1);
+        return -1;
+    }
+
+    if (sim->llc_masks && sim->llc_ucp_epoch > 0) {
+        printf("Use either -llc_masks or -llc_ucp, not both.\nExiting...\n");
+        suggest_help();
+        return -1;
+    }
+    if ((sim->llc_masks || sim->llc_ucp_epoch > 0) && sim->llc_capacity == 0) {
+        printf("Way partitioning needs a shared cache. Please use the -llc flag\nExiting...\n");
+        suggest_help();
+        return -1;
+    }
+    if (sim->llc_masks && sim->n_llc_masks != sim->n_core) {
+        printf("%d way masks given for %d cores.\nExiting...\n", sim->n_llc_masks, sim->n_core);
+        suggest_help();
+        return -1;
+    }
+    if (sim->llc_ucp_epoch > 0 && sim->llc_assoc < sim->n_core) {
+        printf("Utility-based partitioning needs at least one shared cache way per core.\nExiting...\n");
+        suggest_help();
+        return -1;
+    }
+
+    // the config file is read last, once the number of cores is known
+    if (config_path) {
+        int status = load_core_config(sim, config_path);
+        if (status < 0) {
+            printf("Could not read config file '%s'.\nExiting...\n", config_path);
+            suggest_help();
+            return -1;
+        } else if (status > 0) {
+            printf("Config file '%s', line %d: expected <core> <cap> <bsize> <assoc> "
+                    "[lru_on_invalidate] for a core below %d.\nExiting...\n", config_path, status, sim->n_core);
+            suggest_help();
+            return -1;
+        }
+    }
+
+    // every core's blocks have to split into the sectors, config file or not
+    for (i = 0; sim->sector_size > 0 && i < (sim->core_config ? sim->n_core : 1); i++) {
+        int block_size = sim->core_config ? sim->core_config[i].block_size : sim->block_size;
+        if (block_size > 0 && !valid_sector_size(block_size, sim->sector_size)) {
+            printf("Sectors must be no larger than the block, and at most %d per block.\nExiting...\n", SECTOR_MAX);
+            suggest_help();
+            return -1;
+        }
     }
 
     return 1;
@@ -143,15 +430,36 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
 
 int main(int argc, char *argv[]) {
     simulator_t *sim = make_simulator();
+    int status = EXIT_SUCCESS;
 
-    if (parse_args(argv, argc, sim)) {
-        sim->cache = malloc(sim->n_core * sizeof(cache_t*));
-        for (int i = 0; i < sim->n_core; i++){
-            sim->cache[i] = make_cache(capacity, block_size, assoc, sim->protocol, sim->lru_on_invalidate_f);
+    int parsed = parse_args(argv, argc, sim);
+    if (parsed < 0) {
+        status = EXIT_FAILURE;
+    } else if (parsed > 0) {
+        if (setup_simulator(sim) != 0) {
+            printf("Could not set up the simulator (invalid configuration or event log "
+                    "not writable).\nExiting...\n");
+            suggest_help();
+            status = EXIT_FAILURE;
+        } else {
+            print_simulator_header(sim);
+            // this is still where the action takes place
+            int result = (sim->n_mix > 0) ? process_mix(sim) : process_trace(sim);
+            if (result != 0) {
+                status = EXIT_FAILURE;
+            }
+
+            // the log is only known to be complete once the file is closed
+            if (sim->event_log) {
+                if (close_event_log(sim->event_log) != 0 && result == 0) {
+                    printf("ERROR: could not write the event log %s\n", sim->event_log_path);
+                    status = EXIT_FAILURE;
+                }
+                sim->event_log = NULL;
+            }
         }
-        print_simulator_header(sim);
-        process_trace(sim);  // this is still where the action takes place
     }
 
-    return EXIT_SUCCESS;
+    free_simulator(sim);
+    return status;
 }
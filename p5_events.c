@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "event_log.h"
+
+/* Decoder for the binary event logs written by ./p5 -event_log. */
+
+#define READ_CHUNK 4096
+
+static const char *action_names[] = { "ld", "st", "ld_miss", "st_miss" };
+static const char state_chars[] = { 'I', 'V', 'S', 'M' };
+
+void printUsage() {
+    printf("\nUsage: ./p5_events <logfile> [-core <n>] [-set <n>] [-addr <hex>] [-asid <n>]\n");
+    printf("Options:\n");
+    printf("  -c|core <n>      Only show events handled by core n\n");
+    printf("  -s|set <n>       Only show events in set n\n");
+    printf("  -a|addr <hex>    Only show events on the block containing this address\n");
+    printf("  -p|asid <n>      Only show events of process n (logs of -mix runs)\n");
+}
+
+char decode_state(uint8_t state) {
+    return state < sizeof(state_chars) ? state_chars[state] : '?';
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    long core_filter = -1, set_filter = -1, asid_filter = -1;
+    bool addr_filter_f = false;
+    unsigned long addr_filter = 0;
+
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        if (strcmp(arg, "-help") == 0 || strcmp(arg, "-h") == 0) {
+            printUsage();
+            return EXIT_SUCCESS;
+        } else if ((strcmp(arg, "-core") == 0 || strcmp(arg, "-c") == 0) && i + 1 < argc) {
+            core_filter = atol(argv[++i]);
+        } else if ((strcmp(arg, "-set") == 0 || strcmp(arg, "-s") == 0) && i + 1 < argc) {
+            set_filter = atol(argv[++i]);
+        } else if ((strcmp(arg, "-addr") == 0 || strcmp(arg, "-a") == 0) && i + 1 < argc) {
+            addr_filter_f = true;
+            addr_filter = strtoul(argv[++i], NULL, 16);
+        } else if ((strcmp(arg, "-asid") == 0 || strcmp(arg, "-p") == 0) && i + 1 < argc) {
+            asid_filter = atol(argv[++i]);
+        } else if (arg[0] != '-' && path == NULL) {
+            path = arg;
+        } else {
+            printf("Unrecognized argument '%s'\n", arg);
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (path == NULL) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("File '%s' not found\n", path);
+        return EXIT_FAILURE;
+    }
+
+    event_log_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != EVENT_LOG_MAGIC ||
+            header.version != EVENT_LOG_VERSION) {
+        printf("'%s' is not a p5 event log\n", path);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    // compare whole blocks, as the cache does
+    unsigned long block_mask = ~(unsigned long)(header.block_size - 1);
+    printf("# block_size %u, n_core %u%s\n", header.block_size, header.n_core,
+            header.asid_f ? ", addresses as <asid>:<addr>" : "");
+
+    event_record_t records[READ_CHUNK];
+    long n_total = 0, n_shown = 0;
+    size_t n_read;
+    while ((n_read = fread(records, sizeof(event_record_t), READ_CHUNK, file)) > 0) {
+        for (size_t k = 0; k < n_read; k++) {
+            event_record_t *rec = &records[k];
+            n_total++;
+
+            if (core_filter >= 0 && rec->core != core_filter) continue;
+            if (set_filter >= 0 && rec->set != set_filter) continue;
+            if (addr_filter_f && (rec->addr & block_mask) != (addr_filter & block_mask)) continue;
+            if (asid_filter >= 0 && rec->asid != asid_filter) continue;
+
+            n_shown++;
+            printf("%ld %d %-7s ", n_total - 1, rec->core, rec->action < 4 ? action_names[rec->action] : "?");
+            if (header.asid_f) printf("%u:", rec->asid);
+            printf("%08x ==> [set:%4u][way:%u](%c->%c) %s%s%s\n", rec->addr, rec->set, rec->way,
+                    decode_state(rec->old_state), decode_state(rec->new_state),
+                    (rec->flags & EVENT_HIT) ? "hit" : "miss",
+                    (rec->flags & EVENT_WRITEBACK) ? " writeback" : "",
+                    (rec->flags & EVENT_UPGRADE_MISS) ? " upgrade" : "");
+        }
+    }
+
+    fclose(file);
+    printf("# %ld of %ld events shown\n", n_shown, n_total);
+    return EXIT_SUCCESS;
+}
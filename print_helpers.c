@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <math.h>
 
 #include "cache.h"
 #include "cache_stats.h"
@@ -6,17 +7,13 @@
 #include "print_helpers.h"
 
 
-/* fields you might want to have print */
-int print_set = 0;
-int print_way = 0;
-
-
-void log_set(int set) {
-  print_set = set;
+/* fields you might want to have print: kept per cache so there is no global state */
+void log_set(cache_t *cache, int set) {
+  cache->last_set = set;
 }
 
-void log_way(int way) {
-  print_way = way;
+void log_way(cache_t *cache, int way) {
+  cache->last_way = way;
 }
 
 
@@ -24,14 +21,47 @@ void print_simulator_header(simulator_t *sim) {
   printf("P5 Printout for CS 3410\n");
   printf("----------------------------------\n");
 
-  printf("Trace  \t\t%s\n", sim->trace);
+  if (sim->n_mix > 0) {
+    for (int i = 0; i < sim->n_mix; i++) {
+      printf("Mix P%d \t\t%s\n", i, sim->mix_traces[i]);
+    }
+    printf("Quantum \t\t%d\n", sim->quantum);
+    printf("Scheduling \t\t%s\n", sim->migrate_f ? "migrate" : "pinned");
+    printf("Context switch \t\t%s\n", sim->asid_f ? "asid tagged" : "flush");
+  } else {
+    printf("Trace  \t\t%s\n", sim->trace);
+  }
   printf("Instruction Limit \t");
   if (sim->limit_insn_f) {
     printf("%d\n", sim->insn_limit);
   } else {
     printf("none\n");
   }
-  print_cache_config(sim->cache[0]); // caches must be identical, so [0] is fine
+  if (sim->socket_of) {
+    printf("Sockets \t\t");
+    for (int i = 0; i < sim->n_core; i++) {
+      printf("%s%d", i ? "," : "", sim->socket_of[i]);
+    }
+    printf("\n");
+  }
+  if (sim->llc) {
+    printf("Shared cache \t\t%d B, %d B blocks, %d-way, %s\n", sim->llc->capacity, sim->llc->block_size,
+           sim->llc->assoc, sim->llc->ucp_epoch > 0 ? "utility partitioned" :
+           sim->llc->partitioned_f ? "static way masks" : "unpartitioned");
+    if (sim->llc->partitioned_f && sim->llc->ucp_epoch == 0) {
+      for (int i = 0; i < sim->n_core; i++) {
+        printf("Core %d llc way mask \t%lx\n", i, sim->llc->way_mask[i]);
+      }
+    }
+  }
+  if (!heterogeneous_caches(sim)) {
+    print_cache_config(sim->cache[0]); // caches are identical, so [0] is fine
+    return;
+  }
+  for (int i = 0; i < sim->n_core; i++) {
+    printf(" *** Core %d ***\n", i);
+    print_cache_config(sim->cache[i]);
+  }
 }
 
 void print_stats(cache_stats_t *stats, int core) {
@@ -48,11 +78,92 @@ void print_stats(cache_stats_t *stats, int core) {
   printf("%d.n_writebacks \t%ld\n", core, stats->n_writebacks);
   printf("Memory Traffic:\n");
   printf("%d.B_written_bus_to_cache \t%ld\n", core, stats->B_bus_to_cache);
+  if (stats->sector_size) {
+    printf("%d.n_sector_fills \t%ld\n", core, stats->n_sector_fills);
+    printf("%d.n_sector_writebacks \t%ld\n", core, stats->n_sector_writebacks);
+  }
   printf("%d.B_written_cache_to_bus_wb \t%ld\n", core, stats->B_cache_to_bus_wb);
   printf("%d.B_written_cache_to_bus_wt \t%ld\n", core, stats->B_cache_to_bus_wt);
   printf("%d.B_total_traffic_wb \t%ld\n", core, stats->B_total_traffic_wb);
   printf("%d.B_total_traffic_wt \t%ld\n", core, stats->B_total_traffic_wt);
+  if (stats->wt_simulated_f) {
+    printf("Write Buffer:\n");
+    printf("%d.n_wbuf_merges \t%ld\n", core, stats->n_wbuf_merges);
+    printf("%d.n_wbuf_flushes \t%ld\n", core, stats->n_wbuf_flushes);
+    printf("%d.n_wbuf_snoop_flushes \t%ld\n", core, stats->n_wbuf_snoop_flushes);
+    printf("%d.n_wbuf_stalls \t%ld\n", core, stats->n_wbuf_stalls);
+  }
+
+}
+
+/* Summarises how evenly core accesses spread over the sets: the spread of
+ * per-set counts, and how many sets fall in each band around the mean.
+ */
+void print_set_histogram(cache_t *cache, int core) {
+  const char *band_names[] = { "idle", "<0.5x", "0.5-1x", "1-2x", "2-4x", ">=4x" };
+  long bands[6] = { 0 };
+  long total = 0, max_accesses = 0, max_misses = 0;
+  double sum_sq = 0.0;
+  int n_used = 0;
+
+  for (int i = 0; i < cache->n_set; i++) {
+    total += cache->set_accesses[i];
+    if (cache->set_accesses[i] > max_accesses) max_accesses = cache->set_accesses[i];
+    if (cache->set_misses[i] > max_misses) max_misses = cache->set_misses[i];
+    if (cache->set_accesses[i] > 0) n_used++;
+  }
+
+  double mean = total / (double)cache->n_set;
+  for (int i = 0; i < cache->n_set; i++) {
+    double load = cache->set_accesses[i];
+    sum_sq += (load - mean) * (load - mean);
+    if (cache->set_accesses[i] == 0) bands[0]++;
+    else if (load < 0.5 * mean) bands[1]++;
+    else if (load < mean) bands[2]++;
+    else if (load < 2 * mean) bands[3]++;
+    else if (load < 4 * mean) bands[4]++;
+    else bands[5]++;
+  }
 
+  printf("Set Occupancy:\n");
+  printf("%d.n_sets_used \t\t%d\n", core, n_used);
+  printf("%d.set_accesses_mean \t%.1f\n", core, mean);
+  printf("%d.set_accesses_max \t%ld\n", core, max_accesses);
+  printf("%d.set_misses_max \t%ld\n", core, max_misses);
+  printf("%d.set_accesses_cv \t%.2f\n", core, mean > 0 ? sqrt(sum_sq / cache->n_set) / mean : 0.0);
+  for (int b = 0; b < 6; b++) {
+    printf("%d.sets_%s \t\t%ld\n", core, band_names[b], bands[b]);
+  }
+}
+
+void print_llc_stats(llc_core_stats_t *stats, int core, int block_size) {
+  long n_misses = stats->n_accesses - stats->n_hits;
+  printf("%d.llc_accesses \t%ld\n", core, stats->n_accesses);
+  printf("%d.llc_hits \t\t%ld\n", core, stats->n_hits);
+  printf("%d.llc_hit_rate \t%.2f\n", core, stats->n_accesses ? 100.0 * stats->n_hits / stats->n_accesses : 0.0);
+  printf("%d.llc_writebacks \t%ld\n", core, stats->n_writebacks);
+  printf("%d.llc_ways \t\t%d\n", core, stats->n_ways);
+  printf("%d.B_llc_to_memory \t%ld\n", core, (n_misses + stats->n_writebacks) * block_size);
+}
+
+void print_tlb_stats(tlb_stats_t *stats, int core, int block_size) {
+  long n_walk_misses = stats->n_walk_loads - stats->n_walk_hits;
+  printf("TLB:\n");
+  printf("%d.n_tlb_lookups \t%ld\n", core, stats->n_lookups);
+  printf("%d.n_tlb_misses \t%ld\n", core, stats->n_misses);
+  printf("%d.tlb_miss_rate \t%.2f\n", core,
+         stats->n_lookups ? 100.0 * stats->n_misses / stats->n_lookups : 0.0);
+  printf("%d.n_walk_loads \t%ld\n", core, stats->n_walk_loads);
+  printf("%d.n_walk_misses \t%ld\n", core, n_walk_misses);
+  printf("%d.B_walk_traffic \t%ld\n", core, n_walk_misses * block_size);
+}
+
+void print_socket_stats(socket_stats_t *stats, int socket) {
+  printf("S%d.n_local_msgs \t%ld\n", socket, stats->n_local_msgs);
+  printf("S%d.n_cross_msgs \t%ld\n", socket, stats->n_cross_msgs);
+  printf("S%d.B_local \t\t%ld\n", socket, stats->B_local);
+  printf("S%d.B_cross \t\t%ld\n", socket, stats->B_cross);
+  printf("S%d.B_memory \t\t%ld\n", socket, stats->B_memory);
 }
 
 void print_cache_config(cache_t *cache) {
@@ -68,8 +179,45 @@ void print_cache_config(cache_t *cache) {
   printf("n_set \t\t\t%d\n",cache->n_set);
   printf("n_cache_line \t%d\n", cache->n_cache_line);
   printf("tag: %d, index: %d, offset: %d\n", cache->n_tag_bit, cache->n_index_bit, cache->n_offset_bit);
+  if (cache->sectors) {
+    printf("sectors: \t\t%d x %d B\n", cache->n_sector, cache->sector_size);
+  }
+  if (cache->insert_policy == INSERT_DIP) {
+    printf("insertion: \t\tdip (set dueling, vs. mru)\n");
+  }
+  if (cache->index_fn != INDEX_MODULO) {
+    printf("index function: \t%s\n", cache->index_fn == INDEX_XOR ? "xor" :
+           cache->index_fn == INDEX_PRIME ? "prime" : "skew");
+  }
   printf("Coherence Protocol: \t%s\n", cache->protocol == NONE ? "none" : cache->protocol == VI ? "vi" : "msi");
   printf("lru_on_invalidate_f: \t%s\n", cache->lru_on_invalidate_f ? "true" : "false");
+  if (cache->tlb) {
+    printf("tlb: \t\t\t%d entries, %d-way, %d KB pages\n", cache->tlb->n_entry, cache->tlb->assoc,
+           (1 << cache->tlb->page_bits) / 1024);
+  }
+  if (cache->wbuf) {
+    printf("write_buffer: \t\t%d entries, drain every %d accesses\n", cache->wbuf->n_entry,
+           cache->wbuf->drain_interval);
+  }
+}
+
+// adaptive insertion against the shadow cache's default insertion (rates already calculated)
+void print_insertion_stats(cache_t *cache, int core) {
+  cache_stats_t *stats = cache->stats;
+  cache_stats_t *base = cache->shadow->stats;
+  printf("%d.n_low_priority_fills \t%ld\n", core, cache->n_low_priority_fills);
+  printf("%d.psel \t\t%d\n", core, cache->psel);
+  printf("%d.default_hit_rate \t%.2f\n", core, base->hit_rate * 100.0);
+  printf("%d.hit_rate_gained \t%.2f\n", core, (stats->hit_rate - base->hit_rate) * 100.0);
+  printf("%d.B_saved_bus_to_cache \t%ld\n", core, base->B_bus_to_cache - stats->B_bus_to_cache);
+  printf("%d.B_saved_wb \t\t%ld\n", core, base->B_total_traffic_wb - stats->B_total_traffic_wb);
+}
+
+// per-core geometry, printed with the stats when the cores' caches differ
+void print_core_geometry(cache_t *cache, int core) {
+  printf("%d.capacity \t\t%d\n", core, cache->capacity);
+  printf("%d.block_size \t\t%d\n", core, cache->block_size);
+  printf("%d.assoc \t\t%d\n", core, cache->assoc);
 }
 
 char state_to_char(enum state_t state) {
@@ -88,6 +236,8 @@ char state_to_char(enum state_t state) {
 
 
 void print_insn_info(simulator_t *sim, int core, char cmd, unsigned long addr, bool hit_f) {
+  int print_set = sim->cache[core]->last_set;
+  int print_way = sim->cache[core]->last_way;
   printf("%d %c %lx --> {blk: %lx} %s ==> [set:%4d][way:%d](%c,%s)\n", core, cmd,
 	 addr, get_cache_block_addr(sim->cache[core], addr), hit_f ? " hit" : "miss",
 	 print_set, print_way, state_to_char(sim->cache[core]->lines[print_set][print_way].state),
@@ -7,8 +7,8 @@
 #include "simulator.h"
 
 /* if you want verbose mode to work, you will need to call these 2 functions */
-void log_set(int set);
-void log_way(int way);
+void log_set(cache_t *cache, int set);
+void log_way(cache_t *cache, int way);
 
 void print_simulator_header(simulator_t *sim);
 
@@ -16,10 +16,16 @@ void print_insn_info(simulator_t *sim, int core, char cmd, unsigned long address
 void print_trace_stats(cache_stats_t *stats);
 
 void print_stats(cache_stats_t *stats, int core);
+void print_set_histogram(cache_t *cache, int core);
+void print_insertion_stats(cache_t *cache, int core);
+void print_llc_stats(llc_core_stats_t *stats, int core, int block_size);
+void print_tlb_stats(tlb_stats_t *stats, int core, int block_size);
+void print_socket_stats(socket_stats_t *stats, int socket);
 
 char state_to_char(enum state_t state);
 
 void print_cache_config(cache_t *cache);
+void print_core_geometry(cache_t *cache, int core);
 
 
 #endif  // PRINT_HELPERS
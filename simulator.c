@@ -20,79 +20,711 @@ simulator_t *make_simulator() {
 
     sim->lru_on_invalidate_f = false;
 
+    // no cache yet: parse_args or the library fills these in before setup_simulator
+    sim->cache = NULL;
+    sim->capacity = 0;
+    sim->block_size = 0;
+    sim->assoc = 0;
+    sim->core_config = NULL;
+
+    sim->write_buffer_entries = 0;
+    sim->write_buffer_drain_interval = 0;
+
+    sim->n_mix = 0;
+    sim->mix_traces = NULL;
+    sim->quantum = 10000;
+    sim->migrate_f = false;
+    sim->asid_f = false;
+
+    sim->index_fn = INDEX_MODULO;
+    sim->set_histogram_f = false;
+
+    sim->llc_capacity = 0;
+    sim->llc_block_size = 0;
+    sim->llc_assoc = 0;
+    sim->n_llc_masks = 0;
+    sim->llc_masks = NULL;
+    sim->llc_ucp_epoch = 0;
+    sim->llc = NULL;
+
+    sim->sector_size = 0;
+    sim->insert_policy = INSERT_MRU;
+
+    sim->tlb_entries = 0;
+    sim->tlb_assoc = 0;
+    sim->tlb_page_size = 1 << 12;
+
+    sim->n_socket = 1;
+    sim->n_socket_map = 0;
+    sim->socket_of = NULL;
+    sim->socket_stats = NULL;
+
+    sim->event_log_path = NULL;
+    sim->event_log = NULL;
+
+    sim->total_insn = 0;
+    sim->run_core = -1;
+    sim->run_len = 0;
+
     return sim;
 }
 
+/*
+ * Reads per-core cache settings from a config file. Each non-blank line
+ * that does not start with '#' is
+ *     <core> <log capacity> <log block size> <assoc> [lru_on_invalidate]
+ * with sizes given as the log of the value, as for -cache. Cores the file
+ * does not mention keep the shared configuration. Call once n_core is known.
+ * Returns 0 on success, -1 if the file cannot be read, or the (1-based)
+ * number of the first invalid line.
+ */
+int load_core_config(simulator_t *sim, const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[256];
+    int line_no = 0;
+
+    if (file == NULL || sim->n_core <= 0) {
+        if (file) fclose(file);
+        return -1;
+    }
+
+    free(sim->core_config);
+    sim->core_config = malloc(sim->n_core * sizeof(core_config_t));
+    for (int i = 0; i < sim->n_core; i++) {
+        sim->core_config[i].capacity = sim->capacity;
+        sim->core_config[i].block_size = sim->block_size;
+        sim->core_config[i].assoc = sim->assoc;
+        sim->core_config[i].lru_on_invalidate_f = sim->lru_on_invalidate_f;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        int core, log_cap, log_block_size, assoc, n_fields;
+        char flag[32] = "";
+        line_no++;
+
+        char *start = line + strspn(line, " \t");
+        if (*start == '#' || *start == '\n' || *start == '\0') continue;
+
+        n_fields = sscanf(start, "%d %d %d %d %31s", &core, &log_cap, &log_block_size, &assoc, flag);
+        if (n_fields < 4 || core < 0 || core >= sim->n_core ||
+                log_cap < 0 || log_cap > 25 || log_block_size < 0 || log_block_size > 25 ||
+                (n_fields == 5 && strcmp(flag, "lru_on_invalidate") != 0)) {
+            fclose(file);
+            return line_no;
+        }
+
+        sim->core_config[core].capacity = 1 << log_cap;
+        sim->core_config[core].block_size = 1 << log_block_size;
+        sim->core_config[core].assoc = assoc;
+        sim->core_config[core].lru_on_invalidate_f = (n_fields == 5);
+    }
+
+    fclose(file);
+    return 0;
+}
+
+/*
+ * Reads a topology given as a comma separated socket id per core, e.g.
+ * "0,0,1,1" puts cores 0-1 in socket 0 and cores 2-3 in socket 1.
+ * Returns 0 on success, -1 if the map is malformed.
+ */
+int parse_socket_map(simulator_t *sim, const char *map) {
+    int n = 1;
+    for (const char *c = map; *c; c++) {
+        if (*c == ',') n++;
+    }
+
+    free(sim->socket_of);
+    sim->socket_of = malloc(n * sizeof(int));
+    sim->n_socket_map = 0;
+    sim->n_socket = 0;
+
+    const char *c = map;
+    while (sim->n_socket_map < n) {
+        char *end;
+        long socket = strtol(c, &end, 10);
+        if (end == c || socket < 0 || socket > 255 || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        sim->socket_of[sim->n_socket_map++] = socket;
+        if (socket + 1 > sim->n_socket) sim->n_socket = socket + 1;
+        c = end + 1;
+    }
+    return 0;
+}
+
+/*
+ * Reads the shared cache's way masks, one per core, comma separated, in
+ * hex (e.g. "0x0f,0xf0" or "f,f0").
+ * Returns 0 on success, -1 if the list is malformed.
+ */
+int parse_llc_masks(simulator_t *sim, const char *list) {
+    int n = 1;
+    for (const char *c = list; *c; c++) {
+        if (*c == ',') n++;
+    }
+
+    free(sim->llc_masks);
+    sim->llc_masks = malloc(n * sizeof(unsigned long));
+    sim->n_llc_masks = 0;
+
+    const char *c = list;
+    while (sim->n_llc_masks < n) {
+        char *end;
+        unsigned long mask = strtoul(c, &end, 16);
+        if (end == c || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        sim->llc_masks[sim->n_llc_masks++] = mask;
+        c = end + 1;
+    }
+    return 0;
+}
+
+/*
+ * Creates one cache per core from the simulator's configuration, and opens
+ * the event log if one was requested.
+ * Returns 0 on success, -1 if the configuration is invalid or the event
+ * log cannot be created.
+ */
+int setup_simulator(simulator_t *sim) {
+    int i;
+
+    if (sim->n_core <= 0 || sim->write_buffer_entries < 0 || sim->write_buffer_drain_interval < 0 ||
+            sim->n_mix > (1 << ASID_BITS) || (sim->n_mix > 0 && sim->quantum <= 0) ||
+            (sim->socket_of && sim->n_socket_map != sim->n_core) ||
+            (sim->tlb_entries > 0 && !valid_tlb_geometry(sim->tlb_entries, sim->tlb_assoc, sim->tlb_page_size))) {
+        return -1;
+    }
+
+    if (sim->socket_of) {
+        sim->socket_stats = calloc(sim->n_socket, sizeof(socket_stats_t));
+    }
+
+    if (sim->llc_masks && sim->llc_ucp_epoch > 0) {
+        return -1;  // UCP would silently replace the fixed masks
+    }
+    if (sim->llc_capacity > 0) {
+        if (!valid_cache_geometry(sim->llc_capacity, sim->llc_block_size, sim->llc_assoc) ||
+                sim->llc_assoc > LLC_MAX_ASSOC) {
+            return -1;
+        }
+        sim->llc = make_llc(sim->llc_capacity, sim->llc_block_size, sim->llc_assoc, sim->n_core);
+        if (sim->llc_masks && (sim->n_llc_masks != sim->n_core || llc_set_masks(sim->llc, sim->llc_masks) != 0)) {
+            return -1;
+        }
+        if (sim->llc_ucp_epoch > 0 && llc_enable_ucp(sim->llc, sim->llc_ucp_epoch) != 0) {
+            return -1;
+        }
+    } else if (sim->llc_masks || sim->llc_ucp_epoch > 0) {
+        return -1;  // partitioning without a shared cache
+    }
+
+    // without a config file every core gets the shared configuration
+    if (sim->core_config == NULL) {
+        sim->core_config = malloc(sim->n_core * sizeof(core_config_t));
+        for (i = 0; i < sim->n_core; i++) {
+            sim->core_config[i].capacity = sim->capacity;
+            sim->core_config[i].block_size = sim->block_size;
+            sim->core_config[i].assoc = sim->assoc;
+            sim->core_config[i].lru_on_invalidate_f = sim->lru_on_invalidate_f;
+        }
+    }
+
+    // the event log matches addresses by block, so give it the finest block size
+    int min_block_size = sim->core_config[0].block_size;
+    for (i = 0; i < sim->n_core; i++) {
+        core_config_t *config = &sim->core_config[i];
+        if (!valid_cache_geometry(config->capacity, config->block_size, config->assoc) ||
+                (sim->sector_size > 0 && !valid_sector_size(config->block_size, sim->sector_size))) {
+            return -1;
+        }
+        if (config->block_size < min_block_size) {
+            min_block_size = config->block_size;
+        }
+    }
+
+    if (sim->event_log_path) {
+        sim->event_log = open_event_log(sim->event_log_path, min_block_size, sim->n_core, sim->n_mix > 0);
+        if (sim->event_log == NULL) {
+            return -1;
+        }
+    }
+
+    // calloc, so a setup that fails part way leaves free_simulator only NULLs to skip
+    sim->cache = calloc(sim->n_core, sizeof(cache_t*));
+    for (i = 0; i < sim->n_core; i++){
+        core_config_t *config = &sim->core_config[i];
+        sim->cache[i] = make_cache(config->capacity, config->block_size, config->assoc, sim->protocol,
+                config->lru_on_invalidate_f);
+        sim->cache[i]->core_id = i;
+        sim->cache[i]->event_log = sim->event_log;
+        if (sim->index_fn != INDEX_MODULO) {
+            // before enable_asid_tags, which widens whatever tag this leaves
+            set_index_function(sim->cache[i], sim->index_fn);
+        }
+        if (sim->set_histogram_f) {
+            enable_set_histogram(sim->cache[i]);
+        }
+        if (sim->sector_size > 0 && enable_sectors(sim->cache[i], sim->sector_size) != 0) {
+            return -1;
+        }
+        if (sim->n_mix > 0) {
+            // processes are told apart by the ASID above the address, see mix.c
+            enable_asid_tags(sim->cache[i]);
+        }
+        if (sim->insert_policy == INSERT_DIP) {
+            // after everything its shadow copy has to mirror
+            enable_adaptive_insertion(sim->cache[i]);
+        }
+        if (sim->tlb_entries > 0) {
+            sim->cache[i]->tlb = make_tlb(sim->tlb_entries, sim->tlb_assoc, sim->tlb_page_size);
+        }
+        if (sim->write_buffer_entries > 0) {
+            sim->cache[i]->wbuf = make_write_buffer(sim->write_buffer_entries, sim->write_buffer_drain_interval,
+                    config->block_size, sim->cache[i]->stats);
+        }
+    }
+    return 0;
+}
+
+/* Returns true if the cores' caches are not all configured the same. */
+bool heterogeneous_caches(simulator_t *sim) {
+    core_config_t *first = &sim->core_config[0];
+    for (int i = 1; i < sim->n_core; i++) {
+        core_config_t *config = &sim->core_config[i];
+        if (config->capacity != first->capacity || config->block_size != first->block_size ||
+                config->assoc != first->assoc || config->lru_on_invalidate_f != first->lru_on_invalidate_f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Releases the simulator and every cache it owns, flushing the event log. */
+void free_simulator(simulator_t *sim) {
+    if (sim->event_log) {
+        close_event_log(sim->event_log);
+    }
+    if (sim->cache) {
+        for (int i = 0; i < sim->n_core; i++){
+            if (sim->cache[i]) free_cache(sim->cache[i]);
+        }
+        free(sim->cache);
+    }
+    free(sim->core_config);
+    free(sim->mix_traces);
+    free(sim->socket_of);
+    free(sim->socket_stats);
+    free(sim->llc_masks);
+    if (sim->llc) {
+        free_llc(sim->llc);
+    }
+    free(sim);
+}
+
+/*
+ * Parses one trace record of the form "<core> <r|w> <hex address>".
+ * Returns false if the line is not a well formed record.
+ */
+bool parse_trace_line(const char *line, int *core, enum action_t *action, unsigned long *addr) {
+    char *end;
+
+    if (line[0] < '0' || line[0] > '9' || line[1] != ' ' ||
+            (line[2] != 'r' && line[2] != 'w') || line[3] != ' ') {
+        return false;
+    }
+
+    *core = line[0]-'0'; // turn the '0' into a 0
+    *action = (line[2] == 'r') ? LOAD : STORE;
+    *addr = strtoul(&line[4], &end, 16);
+    return end != &line[4];
+}
+
+/*
+ * Delivers a bus event for the block of addr that missed in the issuing
+ * cache to a snooping cache. Each cache derives its own set and tag from
+ * the address, so different set counts need no translation. If the
+ * snooper's blocks are smaller than the issuer's, the issuer's block spans
+ * several of them and each one is snooped, but the stats still count a
+ * single bus snoop (and at most one snoop hit). Sectored caches move data
+ * a sector at a time, so there the sector takes the place of the block.
+ */
+static void snoop_block(cache_t *snooper, cache_t *issuer, unsigned long addr, enum action_t action) {
+    if (snooper->sector_size >= issuer->sector_size) {
+        access_cache(snooper, addr, action);
+        if (snooper->wbuf) write_buffer_snoop(snooper->wbuf, addr);
+        return;
+    }
+
+    cache_stats_t *stats = snooper->stats;
+    long n_bus_snoops = stats->n_bus_snoops;
+    long n_snoop_hits = stats->n_snoop_hits;
+
+    unsigned long sector_addr = get_cache_sector_addr(issuer, addr);
+    for (unsigned long sub = sector_addr; sub < sector_addr + issuer->sector_size; sub += snooper->sector_size) {
+        access_cache(snooper, sub, action);
+        if (snooper->wbuf) write_buffer_snoop(snooper->wbuf, sub);
+    }
+
+    stats->n_bus_snoops = n_bus_snoops + 1;
+    stats->n_snoop_hits = n_snoop_hits + (stats->n_snoop_hits > n_snoop_hits ? 1 : 0);
+}
+
+// true if any cache holding part of the issuer's block for addr has it valid
+static bool probe_block(cache_t *snooper, cache_t *issuer, unsigned long addr) {
+    if (snooper->sector_size >= issuer->sector_size) {
+        return probe_cache(snooper, addr);
+    }
+
+    unsigned long sector_addr = get_cache_sector_addr(issuer, addr);
+    for (unsigned long sub = sector_addr; sub < sector_addr + issuer->sector_size; sub += snooper->sector_size) {
+        if (probe_cache(snooper, sub)) return true;
+    }
+    return false;
+}
+
+// true if the snooper's write buffer holds stores to part of the issuer's block for addr
+static bool wbuf_holds_block(cache_t *snooper, cache_t *issuer, unsigned long addr) {
+    if (!snooper->wbuf) return false;
+    if (snooper->sector_size >= issuer->sector_size) {
+        return write_buffer_holds(snooper->wbuf, addr);
+    }
+
+    unsigned long sector_addr = get_cache_sector_addr(issuer, addr);
+    for (unsigned long sub = sector_addr; sub < sector_addr + issuer->sector_size; sub += snooper->sector_size) {
+        if (write_buffer_holds(snooper->wbuf, sub)) return true;
+    }
+    return false;
+}
+
+/*
+ * Puts a miss from core on the bus of a multi-socket topology. The request
+ * is first snooped by the other cores of its own socket, then forwarded
+ * over the inter-socket link, but only to sockets holding a copy of the
+ * block or buffered stores to it: a snoop that finds neither changes
+ * nothing there, so the others never need to see it. The data comes from
+ * the first cache found holding the block (local before remote),
+ * otherwise from memory.
+ */
+static void snoop_sockets(simulator_t *sim, int core, unsigned long address, enum action_t action) {
+    cache_t *issuer = sim->cache[core];
+    int home = sim->socket_of[core];
+    socket_stats_t *stats = &sim->socket_stats[home];
+    enum action_t snoop = (action == LOAD) ? LD_MISS : ST_MISS;
+    // an upgrade miss already has the data and only needs the invalidation
+    bool supplied_f = issuer->last_upgrade_f;
+    int i, s;
+
+    // the local bus
+    stats->n_local_msgs++;
+    for (i = 0; i < sim->n_core; i++) {
+        if (i == core || sim->socket_of[i] != home) continue;
+        if (!supplied_f && probe_block(sim->cache[i], issuer, address)) {
+            stats->B_local += issuer->sector_size;
+            supplied_f = true;
+        }
+        snoop_block(sim->cache[i], issuer, address, snoop);
+    }
+
+    // the inter-socket link
+    for (s = 0; s < sim->n_socket; s++) {
+        bool present_f = false;
+        if (s == home) continue;
+        for (i = 0; i < sim->n_core && !present_f; i++) {
+            present_f = (sim->socket_of[i] == s) && (probe_block(sim->cache[i], issuer, address) ||
+                    wbuf_holds_block(sim->cache[i], issuer, address));
+        }
+        if (!present_f) continue;
+
+        stats->n_cross_msgs++;
+        sim->socket_stats[s].n_local_msgs++;
+        if (!supplied_f) {
+            stats->B_cross += issuer->sector_size;
+            supplied_f = true;
+        }
+        for (i = 0; i < sim->n_core; i++) {
+            if (sim->socket_of[i] == s) snoop_block(sim->cache[i], issuer, address, snoop);
+        }
+    }
+
+    if (!supplied_f) {
+        stats->B_memory += issuer->sector_size;
+    }
+}
+
+/*
+ * Everything that follows a core's own cache access: the write buffer,
+ * verbose printing, and putting a miss on the bus for the other cores.
+ */
+static void complete_access(simulator_t *sim, int core, unsigned long address, enum action_t action, bool hit_f) {
+    int i;
+
+    // write-through: every store also goes to the core's write buffer
+    write_buffer_t *wbuf = sim->cache[core]->wbuf;
+    if (wbuf) {
+        write_buffer_tick(wbuf);
+        if (action == STORE) write_buffer_store(wbuf, address);
+    }
+
+    // a miss that needs data looks in the shared cache next
+    if (!hit_f && sim->llc && !sim->cache[core]->last_upgrade_f) {
+        llc_access(sim->llc, core, address, action == STORE);
+    }
+
+    // prints the insn (verbose runs only ever hold a single access)
+    if (sim->verbose_f) print_insn_info(sim, core, (action == LOAD) ? 'r' : 'w', address, hit_f);
+
+    // misses go on the bus
+    // (LOAD --> LD_MISS, STORE --> ST_MISS)
+    if (!hit_f && sim->socket_stats) {
+        snoop_sockets(sim, core, address, action);
+    } else if (!hit_f) {
+        for (i = 0; i < sim->n_core; i++){ // 1 core? does nothing
+            if (i != core) {
+                snoop_block(sim->cache[i], sim->cache[core], address,
+                        (action == LOAD) ? LD_MISS : ST_MISS);
+            }
+        }
+    }
+}
+
+static void translate(simulator_t *sim, int core, unsigned long addr, bool now_f);
+
+/*
+ * Runs the pending batch of accesses from one core through its cache, then
+ * puts each miss on the bus for the other cores to snoop, in trace order.
+ * Deferring the snoops to the end of the run is safe: the core's own
+ * accesses never touch the other caches, and the snoops never touch the
+ * issuing core's cache.
+ */
+static void flush_run(simulator_t *sim) {
+    unsigned long hits[HIT_BITMAP_WORDS(ACCESS_BATCH_MAX)];
+    const int bits_per_word = 8 * sizeof(unsigned long);
+    int k;
+
+    // short runs (most runs of an interleaved multicore trace) are cheaper
+    // one access at a time than through the batch's bitmap and prefetch pass
+    if (sim->run_len < BATCH_MIN_RUN) {
+        cache_t *cache = sim->cache[sim->run_core];
+        for (k = 0; k < sim->run_len; k++) {
+            bool hit_f = access_cache(cache, sim->run_addrs[k], sim->run_actions[k]);
+            if (sim->run_walk_f[k] && hit_f) cache->tlb->stats.n_walk_hits++;
+            complete_access(sim, sim->run_core, sim->run_addrs[k], sim->run_actions[k], hit_f);
+        }
+        sim->run_len = 0;
+        return;
+    }
+
+    access_cache_batch(sim->cache[sim->run_core], sim->run_addrs, sim->run_actions, sim->run_len, hits);
+
+    for (k = 0; k < sim->run_len; k++) {
+        bool hit_f = (hits[k / bits_per_word] >> (k % bits_per_word)) & 1;
+        if (sim->run_walk_f[k] && hit_f) sim->cache[sim->run_core]->tlb->stats.n_walk_hits++;
+        complete_access(sim, sim->run_core, sim->run_addrs[k], sim->run_actions[k], hit_f);
+    }
+
+    sim->run_len = 0;
+}
+
+/*
+ * Like simulate_access, but performs the access immediately (after any
+ * queued ones) and returns whether it hit. The core must exist.
+ */
+bool simulate_access_now(simulator_t *sim, int core, enum action_t action, unsigned long addr) {
+    finish_accesses(sim);
+
+    sim->total_insn++;
+    if (sim->cache[core]->tlb) translate(sim, core, addr, true);
+
+    bool hit_f = access_cache(sim->cache[core], addr, action);
+    complete_access(sim, core, addr, action, hit_f);
+    return hit_f;
+}
+
+// adds an access to the current run, processing the run first if it cannot take it
+static void enqueue_access(simulator_t *sim, int core, enum action_t action, unsigned long addr, bool walk_f) {
+    // verbose mode prints the cache state right after each access, and the
+    // socket traffic and shared cache need each access's last_upgrade_f, so
+    // those don't batch
+    int run_max = (sim->verbose_f || sim->socket_stats || sim->llc) ? 1 : ACCESS_BATCH_MAX;
+
+    // a different core or a full buffer ends the current run
+    if (sim->run_len > 0 && (core != sim->run_core || sim->run_len == run_max)) {
+        flush_run(sim);
+    }
+
+    sim->run_core = core;
+    sim->run_addrs[sim->run_len] = addr;
+    sim->run_actions[sim->run_len] = action;
+    sim->run_walk_f[sim->run_len] = walk_f;
+    sim->run_len++;
+}
+
+/*
+ * Looks addr up in the core's TLB. On a miss the page walk's loads go
+ * through the core's data cache ahead of the access itself: queued into
+ * the current run, or performed right away if now_f.
+ */
+static void translate(simulator_t *sim, int core, unsigned long addr, bool now_f) {
+    tlb_t *tlb = sim->cache[core]->tlb;
+    unsigned long walk[MAX_WALK_LEVELS];
+
+    if (tlb_lookup(tlb, addr)) {
+        return;
+    }
+
+    int n_walk = page_walk_addrs(tlb, addr, walk);
+    for (int k = 0; k < n_walk; k++) {
+        tlb->stats.n_walk_loads++;
+        if (now_f) {
+            bool hit_f = access_cache(sim->cache[core], walk[k], LOAD);
+            complete_access(sim, core, walk[k], LOAD, hit_f);
+            if (hit_f) tlb->stats.n_walk_hits++;
+        } else {
+            enqueue_access(sim, core, LOAD, walk[k], true);
+        }
+    }
+}
+
+/*
+ * Simulates one access by the given core. Accesses are queued into runs
+ * from the same core and processed in batches, so call finish_accesses
+ * before reading any statistics.
+ * Returns 0 on success, -1 if the core does not exist.
+ */
+int simulate_access(simulator_t *sim, int core, enum action_t action, unsigned long addr) {
+    if (core < 0 || core > (sim->n_core - 1)) {
+        return -1;
+    }
+
+    sim->total_insn++;
+    if (sim->cache[core]->tlb) translate(sim, core, addr, false);
+
+    enqueue_access(sim, core, action, addr, false);
+    return 0;
+}
+
+/* Processes any accesses still waiting in the current run. */
+void finish_accesses(simulator_t *sim) {
+    if (sim->run_len > 0) {
+        flush_run(sim);
+    }
+}
+
+/* Opens a trace by name from the trace/ directory. Returns NULL if it is missing. */
+FILE *open_trace(const char *name) {
+    char *path = malloc(strlen(name) + 7);
+    strncpy(path, "trace/", 7);
+    strcat(path, name);
+    FILE *trace = fopen(path, "r");
+    free(path);
+    return trace;
+}
+
 /*
  * Goes through the trace line by line (i.e., instruction by
  * instruction) and simulates the program being executed on a
  * multicore processor.
+ * Returns 0 on success, -1 if the trace cannot be read or is invalid.
  */
-void process_trace(simulator_t *sim) {
-    int i;
+int process_trace(simulator_t *sim) {
     char *line = NULL;
-    // Program Stats
-    long total_insn = 0;
+    int status = 0;
 
     printf("Processing trace...\n");
     printf("%d %d\n", sim->n_core, sim->protocol);
 
-    char *path = malloc(strlen(sim->trace) + 7);
-    strncpy(path, "trace/", 7);
-    strcat(path, sim->trace);
-    FILE *trace = fopen(path, "r");
+    FILE *trace = open_trace(sim->trace);
     if (trace == NULL) {
         printf("File \'%s\' not found\n", sim->trace);
-        exit(EXIT_FAILURE);
+        return -1;
     }
     size_t len = 0;
-    size_t read;
+    ssize_t read;
 
     while ((read = getline(&line, &len, trace)) != -1) {
-        if (sim->limit_insn_f && total_insn == sim->insn_limit) {
+        if (sim->limit_insn_f && sim->total_insn == sim->insn_limit) {
             printf("Reached insn limit of %d. Ending Simulation...\n",
                     sim->insn_limit);
             break;
         }
 
-        int core = line[0]-'0'; // turn the '0' into a 0
-        if (core > (sim->n_core - 1)) {
-            printf("ERROR: this trace requires atleast %d cores!\n", core + 1);
-            exit(EXIT_FAILURE);
+        int core;
+        enum action_t action;
+        unsigned long address;
+        if (!parse_trace_line(line, &core, &action, &address)) {
+            // tolerate blank lines, but nothing else
+            if (line[0] == '\n' || line[0] == '\0') continue;
+            printf("ERROR: malformed trace line %ld: %s", sim->total_insn + 1, line);
+            status = -1;
+            break;
         }
 
-        enum action_t action = (line[2] == 'r') ? LOAD : STORE;
-        unsigned long address = strtol(&line[4], NULL, 16);
-
-        total_insn++;
-
-        // access the cache
-        bool hit_f = access_cache(sim->cache[core], address, action);
+        if (core < 0 || core >= sim->n_core) {
+            printf("ERROR: this trace requires atleast %d cores!\n", core + 1);
+            status = -1;
+            break;
+        }
 
-        // prints the insn
-        if (sim->verbose_f) print_insn_info(sim, core, line[2], address, hit_f);
+        // access the cache right away: runs in the traces are too short
+        // (about 2 accesses in trace.2t.long) for batching to pay off
+        simulate_access_now(sim, core, action, address);
+    }
 
-        // misses go on the bus
-        // (LOAD --> LD_MISS, STORE --> ST_MISS)
-        if (!hit_f) { 
-            for (i = 0; i < sim->n_core; i++){ // 1 core? does nothing
-                if (i != core) {
-                    access_cache(sim->cache[i], address,
-                            (action == LOAD) ? LD_MISS : ST_MISS);
-                }  
-            }
-        }
+    finish_accesses(sim);
+    if (sim->event_log && flush_event_log(sim->event_log) != 0) {
+        printf("ERROR: could not write the event log %s\n", sim->event_log_path);
+        status = -1;
     }
 
     fclose(trace);
     if (line) free(line);
 
-    printf("Processed %ld lines.\n", total_insn);
+    if (status != 0) {
+        return status;
+    }
+
+    printf("Processed %ld lines.\n", sim->total_insn);
+    report_results(sim);
+    return 0;
+}
+
+/* Computes and prints every core's statistics at the end of a run. */
+void report_results(simulator_t *sim) {
+    int i;
+
+    // the run is over: whatever is still buffered goes out to the bus
+    for (i = 0; i < sim->n_core; i++){
+        if (sim->cache[i]->wbuf) drain_write_buffer(sim->cache[i]->wbuf);
+    }
 
     // compute cache statistics
     for (i = 0; i < sim->n_core; i++){
         calculate_stat_rates(sim->cache[i]->stats, sim->cache[i]->block_size);  
         printf("    *** Results for Core %d ***\n", i);
+        if (heterogeneous_caches(sim)) print_core_geometry(sim->cache[i], i);
         print_stats(sim->cache[i]->stats, i);
+        if (sim->cache[i]->shadow) {
+            calculate_stat_rates(sim->cache[i]->shadow->stats, sim->cache[i]->block_size);
+            print_insertion_stats(sim->cache[i], i);
+        }
+        if (sim->cache[i]->set_accesses) print_set_histogram(sim->cache[i], i);
+        if (sim->cache[i]->tlb) print_tlb_stats(&sim->cache[i]->tlb->stats, i, sim->cache[i]->sector_size);
+    }
+
+    if (sim->llc) {
+        printf("    *** Shared Cache ***\n");
+        for (i = 0; i < sim->n_core; i++) {
+            print_llc_stats(&sim->llc->stats[i], i, sim->llc->block_size);
+        }
+        printf("llc.n_repartitions \t%ld\n", sim->llc->n_repartitions);
+    }
+
+    if (sim->socket_stats) {
+        printf("    *** Socket Traffic ***\n");
+        for (i = 0; i < sim->n_socket; i++) {
+            print_socket_stats(&sim->socket_stats[i], i);
+        }
     }
 }
@@ -2,8 +2,27 @@
 #define __SIMULATOR_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "cache.h"
 #include "cache_stats.h"
+#include "llc.h"
+
+// geometry and replacement settings of one core's cache
+typedef struct {
+  int capacity;    // in Bytes
+  int block_size;  // in Bytes
+  int assoc;
+  bool lru_on_invalidate_f;
+} core_config_t;
+
+// coherence traffic seen by one socket in a multi-socket topology
+typedef struct {
+  long n_local_msgs;  // requests broadcast on this socket's own snooping bus
+  long n_cross_msgs;  // requests this socket forwarded over the inter-socket link
+  long B_local;       // bytes its misses got from a cache in the same socket
+  long B_cross;       // bytes its misses got from a cache in another socket
+  long B_memory;      // bytes its misses got from memory
+} socket_stats_t;
 
 typedef struct {
   char* trace;
@@ -22,10 +41,92 @@ typedef struct {
   cache_t** cache;
 
   enum protocol_t protocol;
+
+  // cache configuration used for every core, in Bytes
+  int capacity;
+  int block_size;
+  int assoc;
+
+  // per-core cache configuration, one entry per core. NULL until
+  // load_core_config or setup_simulator fills it in (the latter copies the
+  // shared configuration above to every core)
+  core_config_t *core_config;
+
+  // simulated write-through: per-core write buffer size in blocks (0 = estimate
+  // wt traffic instead) and how many accesses between background drains
+  int write_buffer_entries;
+  int write_buffer_drain_interval;
+
+  // multiprogrammed mode (see mix.h): independent single-thread traces
+  // scheduled onto the cores instead of one trace naming its cores
+  int n_mix;
+  char **mix_traces;
+  int quantum;      // accesses per time slice
+  bool migrate_f;   // processes may move between cores (otherwise pinned round-robin)
+  bool asid_f;      // lines are ASID tagged, so context switches do not flush
+
+  // set index function for every cache, and whether to collect per-set counts
+  enum index_fn_t index_fn;
+  bool set_histogram_f;
+
+  // sector size of every cache's lines, in Bytes (0 = unsectored)
+  int sector_size;
+
+  // where misses are inserted in every cache (INSERT_DIP also reports the
+  // difference from default insertion)
+  enum insert_policy_t insert_policy;
+
+  // shared last-level cache (llc_capacity = 0 means none), with optional
+  // static way masks (one per core) or utility-based repartitioning
+  int llc_capacity;
+  int llc_block_size;
+  int llc_assoc;
+  int n_llc_masks;
+  unsigned long *llc_masks;
+  int llc_ucp_epoch;
+  llc_t *llc;
+
+  // per-core TLB (tlb_entries = 0 means no translation is simulated)
+  int tlb_entries;
+  int tlb_assoc;
+  int tlb_page_size;  // in Bytes: 4K, 2M or 1G
+
+  // multi-socket topology: socket_of[core] is the socket each core sits in.
+  // n_socket <= 1 means one flat snooping bus
+  int n_socket;
+  int n_socket_map;  // entries given in socket_of, must match n_core
+  int *socket_of;
+  socket_stats_t *socket_stats;
+
+  // optional binary event log of every access and snoop (NULL path = off)
+  char *event_log_path;
+  event_log_t *event_log;
+
+  // accesses simulated so far
+  long total_insn;
+
+  // the current run of consecutive accesses from a single core, waiting to be batched
+  unsigned long run_addrs[ACCESS_BATCH_MAX];
+  enum action_t run_actions[ACCESS_BATCH_MAX];
+  bool run_walk_f[ACCESS_BATCH_MAX];  // the access is a page table load
+  int run_core;
+  int run_len;
   
 } simulator_t;
 
 simulator_t* make_simulator();
-void process_trace(simulator_t *sim);
+int load_core_config(simulator_t *sim, const char *path);
+int parse_socket_map(simulator_t *sim, const char *map);
+int parse_llc_masks(simulator_t *sim, const char *list);
+int setup_simulator(simulator_t *sim);
+bool heterogeneous_caches(simulator_t *sim);
+void free_simulator(simulator_t *sim);
+bool parse_trace_line(const char *line, int *core, enum action_t *action, unsigned long *addr);
+int simulate_access(simulator_t *sim, int core, enum action_t action, unsigned long addr);
+bool simulate_access_now(simulator_t *sim, int core, enum action_t action, unsigned long addr);
+void finish_accesses(simulator_t *sim);
+void report_results(simulator_t *sim);
+FILE *open_trace(const char *name);
+int process_trace(simulator_t *sim);
 
 #endif  // SIMULATOR
@@ -0,0 +1,113 @@
+#include <stdlib.h>
+
+#include "cache.h"
+#include "tlb.h"
+
+tlb_t *make_tlb(int n_entry, int assoc, int page_size) {
+  tlb_t *tlb = malloc(sizeof(tlb_t));
+
+  tlb->n_entry = n_entry;
+  tlb->assoc = assoc;
+  tlb->n_set = n_entry / assoc;
+  tlb->page_bits = 0;
+  while ((1 << tlb->page_bits) < page_size) {
+    tlb->page_bits++;
+  }
+
+  // calloc leaves every entry invalid
+  tlb->entries = calloc(n_entry, sizeof(tlb_entry_t));
+  tlb->clock = 0;
+
+  tlb->stats.n_lookups = 0;
+  tlb->stats.n_misses = 0;
+  tlb->stats.n_walk_loads = 0;
+  tlb->stats.n_walk_hits = 0;
+
+  return tlb;
+}
+
+void free_tlb(tlb_t *tlb) {
+  free(tlb->entries);
+  free(tlb);
+}
+
+/* Returns true if the TLB settings are usable: 4K, 2M or 1G pages and a
+ * whole number of sets.
+ */
+bool valid_tlb_geometry(int n_entry, int assoc, int page_size) {
+  if (page_size != (1 << 12) && page_size != (1 << 21) && page_size != (1 << 30)) {
+    return false;
+  }
+  return n_entry > 0 && assoc > 0 && n_entry % assoc == 0;
+}
+
+/* Translates addr. Returns true on a TLB hit; on a miss the translation is
+ * installed in place of the set's least recently used entry, and the
+ * caller is expected to perform the page walk.
+ */
+bool tlb_lookup(tlb_t *tlb, unsigned long addr) {
+  unsigned long vpn = addr >> tlb->page_bits;
+  tlb_entry_t *set = &tlb->entries[(vpn % tlb->n_set) * tlb->assoc];
+  tlb_entry_t *victim = &set[0];
+
+  tlb->clock++;
+  tlb->stats.n_lookups++;
+
+  for (int i = 0; i < tlb->assoc; i++) {
+    if (set[i].valid_f && set[i].vpn == vpn) {
+      set[i].last_use = tlb->clock;
+      return true;
+    }
+    // prefer an empty entry, otherwise the least recently used
+    if (victim->valid_f && (!set[i].valid_f || set[i].last_use < victim->last_use)) {
+      victim = &set[i];
+    }
+  }
+
+  tlb->stats.n_misses++;
+  victim->vpn = vpn;
+  victim->valid_f = true;
+  victim->last_use = tlb->clock;
+  return false;
+}
+
+/* Fills walk with the page table entry addresses a walk for addr loads,
+ * from the root down, and returns how many there are.
+ *
+ * Level l covers virtual address bits [12 + 9l, 12 + 9(l+1)); its tables
+ * sit in their own region, one 4K table per value of the bits above. Any
+ * bits above the ADDRESS_SIZE-bit address (the ASID in a -mix run) are
+ * carried over, so each process walks its own tables.
+ */
+int page_walk_addrs(tlb_t *tlb, unsigned long addr, unsigned long *walk) {
+  const unsigned long table_size = 1UL << (PT_INDEX_BITS + 3);  // 512 entries of 8 Bytes
+  unsigned long space = addr & ~((1UL << ADDRESS_SIZE) - 1);
+  unsigned long vaddr = addr & ((1UL << ADDRESS_SIZE) - 1);
+  unsigned long region = PAGE_TABLE_BASE;
+  int first_level = (tlb->page_bits - 12) / PT_INDEX_BITS;
+  int n = 0;
+
+  // regions are laid out from the leaf level up; find the base of each
+  unsigned long base[MAX_WALK_LEVELS];
+  for (int l = 0; l < MAX_WALK_LEVELS; l++) {
+    int shift = 12 + PT_INDEX_BITS * (l + 1);
+    unsigned long n_tables = (shift < ADDRESS_SIZE) ? 1UL << (ADDRESS_SIZE - shift) : 1;
+    base[l] = region;
+    region += n_tables * table_size;
+  }
+
+  for (int l = MAX_WALK_LEVELS - 1; l >= first_level; l--) {
+    int shift = 12 + PT_INDEX_BITS * l;
+    unsigned long index = (vaddr >> shift) & ((1UL << PT_INDEX_BITS) - 1);
+    unsigned long table = (shift + PT_INDEX_BITS < ADDRESS_SIZE) ? vaddr >> (shift + PT_INDEX_BITS) : 0;
+    walk[n++] = space | (base[l] + table * table_size + index * PTE_SIZE);
+  }
+  return n;
+}
+
+/* Invalidates every translation, as a context switch without ASIDs does. */
+void flush_tlb(tlb_t *tlb) {
+  for (int i = 0; i < tlb->n_entry; i++) {
+    tlb->entries[i].valid_f = false;
+  }
+}
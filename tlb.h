@@ -0,0 +1,52 @@
+#ifndef __TLB_H
+#define __TLB_H
+
+#include <stdbool.h>
+
+/* Per-core TLB with a radix page table walked through the data cache.
+ *
+ * The page table has 8-byte entries and 9 index bits per level, covering
+ * the ADDRESS_SIZE-bit virtual address: a 4K page takes 3 levels to
+ * translate, a 2M page 2 and a 1G page 1. The tables live at
+ * PAGE_TABLE_BASE, one region per level, so a walk turns into a fixed
+ * sequence of loads the cache model can simulate.
+ */
+
+#define PAGE_TABLE_BASE 0xff000000UL  // above anything the traces touch
+#define PTE_SIZE 8                    // in Bytes
+#define PT_INDEX_BITS 9               // entries per table = 2^9
+#define MAX_WALK_LEVELS 3
+
+typedef struct {
+  unsigned long vpn;
+  bool valid_f;
+  long last_use;  // for LRU
+} tlb_entry_t;
+
+typedef struct {
+  long n_lookups;
+  long n_misses;
+  long n_walk_loads;  // page table loads sent to the data cache
+  long n_walk_hits;   // of those, the ones that hit
+} tlb_stats_t;
+
+typedef struct {
+  int n_entry;
+  int assoc;
+  int n_set;
+  int page_bits;  // 12, 21 or 30
+
+  tlb_entry_t *entries;  // n_set rows of assoc entries
+  long clock;            // lookup counter, stamps last_use
+
+  tlb_stats_t stats;
+} tlb_t;
+
+tlb_t *make_tlb(int n_entry, int assoc, int page_size);
+void free_tlb(tlb_t *tlb);
+bool valid_tlb_geometry(int n_entry, int assoc, int page_size);
+bool tlb_lookup(tlb_t *tlb, unsigned long addr);
+int page_walk_addrs(tlb_t *tlb, unsigned long addr, unsigned long *walk);
+void flush_tlb(tlb_t *tlb);
+
+#endif  // TLB
@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "write_buffer.h"
+
+write_buffer_t *make_write_buffer(int n_entry, int drain_interval, int block_size, cache_stats_t *stats) {
+  write_buffer_t *wbuf = malloc(sizeof(write_buffer_t));
+
+  wbuf->n_entry = n_entry;
+  wbuf->drain_interval = drain_interval;
+  wbuf->block_size = block_size;
+  // a block smaller than a word still takes whole-word stores
+  wbuf->words_per_block = (block_size >= WT_WORD_SIZE) ? block_size / WT_WORD_SIZE : 1;
+
+  // each entry gets its own word mask, allocated once up front
+  wbuf->entries = malloc(n_entry * sizeof(write_buffer_entry_t));
+  for (int i = 0; i < n_entry; i++) {
+    wbuf->entries[i].block_addr = 0;
+    wbuf->entries[i].word_mask = calloc(WORD_MASK_LONGS(wbuf->words_per_block), sizeof(unsigned long));
+  }
+  wbuf->count = 0;
+  wbuf->ticks = 0;
+
+  wbuf->stats = stats;
+  stats->wt_simulated_f = true;
+
+  return wbuf;
+}
+
+void free_write_buffer(write_buffer_t *wbuf) {
+  for (int i = 0; i < wbuf->n_entry; i++) {
+    free(wbuf->entries[i].word_mask);
+  }
+  free(wbuf->entries);
+  free(wbuf);
+}
+
+/* Sends entry i to the bus and removes it, keeping the rest in age order. */
+static void flush_entry(write_buffer_t *wbuf, int i) {
+  write_buffer_entry_t flushed = wbuf->entries[i];
+
+  wbuf->stats->n_wbuf_flushes++;
+  memset(flushed.word_mask, 0, WORD_MASK_LONGS(wbuf->words_per_block) * sizeof(unsigned long));
+
+  // shift the younger entries down and recycle the flushed entry's mask at the end
+  memmove(&wbuf->entries[i], &wbuf->entries[i + 1], (wbuf->count - i - 1) * sizeof(write_buffer_entry_t));
+  wbuf->count--;
+  wbuf->entries[wbuf->count] = flushed;
+}
+
+/* Buffers a store. Stores to a block already in the buffer are combined
+ * with it; otherwise a new entry is allocated, stalling to drain the oldest
+ * entry first if the buffer is full.
+ */
+void write_buffer_store(write_buffer_t *wbuf, unsigned long addr) {
+  const int bits_per_word = 8 * sizeof(unsigned long);
+  unsigned long block_addr = addr & ~(unsigned long)(wbuf->block_size - 1);
+  int word = (wbuf->block_size >= WT_WORD_SIZE) ? (addr & (wbuf->block_size - 1)) / WT_WORD_SIZE : 0;
+  write_buffer_entry_t *entry = NULL;
+
+  for (int i = 0; i < wbuf->count; i++) {
+    if (wbuf->entries[i].block_addr == block_addr) {
+      entry = &wbuf->entries[i];
+      wbuf->stats->n_wbuf_merges++;
+      break;
+    }
+  }
+
+  if (entry == NULL) {
+    if (wbuf->count == wbuf->n_entry) {
+      // no room: the store waits for the oldest entry to drain
+      wbuf->stats->n_wbuf_stalls++;
+      flush_entry(wbuf, 0);
+    }
+    entry = &wbuf->entries[wbuf->count++];
+    entry->block_addr = block_addr;
+  }
+
+  // only the first store to a word adds bytes to the eventual flush
+  unsigned long bit = 1UL << (word % bits_per_word);
+  if (!(entry->word_mask[word / bits_per_word] & bit)) {
+    entry->word_mask[word / bits_per_word] |= bit;
+    wbuf->stats->B_wbuf_written += WT_WORD_SIZE;
+  }
+}
+
+/* Called once per access of the owning core: drains the oldest entry in
+ * the background every drain_interval accesses.
+ */
+void write_buffer_tick(write_buffer_t *wbuf) {
+  if (wbuf->drain_interval == 0) {
+    return;
+  }
+  if (++wbuf->ticks >= wbuf->drain_interval) {
+    wbuf->ticks = 0;
+    if (wbuf->count > 0) {
+      flush_entry(wbuf, 0);
+    }
+  }
+}
+
+/* Returns the index of the entry buffering the block of addr, or -1. */
+static int find_entry(const write_buffer_t *wbuf, unsigned long addr) {
+  unsigned long block_addr = addr & ~(unsigned long)(wbuf->block_size - 1);
+
+  for (int i = 0; i < wbuf->count; i++) {
+    if (wbuf->entries[i].block_addr == block_addr) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* True if stores to the block of addr are still waiting in the buffer. */
+bool write_buffer_holds(const write_buffer_t *wbuf, unsigned long addr) {
+  return find_entry(wbuf, addr) >= 0;
+}
+
+/* Another core missed on addr: memory has to be current, so a buffered
+ * write to that block is flushed right away.
+ */
+void write_buffer_snoop(write_buffer_t *wbuf, unsigned long addr) {
+  int i = find_entry(wbuf, addr);
+
+  if (i >= 0) {
+    wbuf->stats->n_wbuf_snoop_flushes++;
+    flush_entry(wbuf, i);
+  }
+}
+
+/* Flushes everything still buffered, e.g. at the end of the trace. */
+void drain_write_buffer(write_buffer_t *wbuf) {
+  while (wbuf->count > 0) {
+    flush_entry(wbuf, 0);
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef __WRITE_BUFFER_H
+#define __WRITE_BUFFER_H
+
+#include <stdbool.h>
+#include "cache_stats.h"
+
+#define WT_WORD_SIZE 4  // in Bytes, the size of every store in the trace
+// number of unsigned longs in a word mask covering n words
+#define WORD_MASK_LONGS(n) (((n) + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long)))
+
+/* Per-core write buffer used to simulate write-through traffic.
+ * Each entry holds one block and remembers which words of it were stored
+ * to, so repeated stores to the same block (or word) are combined into a
+ * single bus write when the entry is flushed.
+ */
+typedef struct {
+  unsigned long block_addr;
+  unsigned long *word_mask;  // bit per word of the block that has been written
+} write_buffer_entry_t;
+
+typedef struct {
+  int n_entry;         // capacity of the buffer, in blocks
+  int drain_interval;  // retire the oldest entry every this many accesses (0 = only when full)
+  int block_size;      // in Bytes
+  int words_per_block;
+
+  // entries[0] is the oldest; entries[0..count) are occupied
+  write_buffer_entry_t *entries;
+  int count;
+
+  int ticks;  // accesses since the last background drain
+
+  cache_stats_t *stats;  // the owning cache's stats
+} write_buffer_t;
+
+write_buffer_t *make_write_buffer(int n_entry, int drain_interval, int block_size, cache_stats_t *stats);
+void free_write_buffer(write_buffer_t *wbuf);
+void write_buffer_store(write_buffer_t *wbuf, unsigned long addr);
+void write_buffer_tick(write_buffer_t *wbuf);
+bool write_buffer_holds(const write_buffer_t *wbuf, unsigned long addr);
+void write_buffer_snoop(write_buffer_t *wbuf, unsigned long addr);
+void drain_write_buffer(write_buffer_t *wbuf);
+
+#endif  // WRITE_BUFFER